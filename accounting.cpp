@@ -0,0 +1,98 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "accounting.h"
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+const char* const structureNames[STRUCTURES] = { "AS nodes", "link nodes", "triplet nodes", "cone elements", "cone buffers", "transit pairs", "VP visibility" };
+
+// Helper function
+// Number of elements of the structure s owned by an AS (buffers are weighted by their elements)
+inline size_t elements( const ASData& d, Structure s )
+{
+    size_t n = 0;
+
+    switch ( s )
+    {
+        case AS_NODES:
+            return 1;
+        case LINK_NODES:
+            return d.size();
+        case TRIPLET_NODES:
+            for ( ASData::const_iterator it = d.begin(); it != d.end(); ++it )
+                n += it->second.size();
+            return n;
+        case CONE_ELEMENTS:
+            return d.customerCone.size() + d.providerCone.size();
+        case CONE_BUFFERS:
+            return d.providers.size() + d.coneSketch.size();
+        case TRANSIT_PAIRS:
+            return d.transitPairs.size();
+        default:
+            return d.visibilityAsVP.size();
+    }
+}
+
+void printMemoryReport( const Data& data, const string& stage, unsigned int top, ostream& os )
+{
+    long totalNodes = 0, totalBytes = 0, totalHeld = 0;
+
+    for ( unsigned int s = 0; s < STRUCTURES; ++s )
+    {
+        const TaggedResource& r = data.structures[s];
+
+        os << "memory [" << stage << "] : " << structureNames[s] << ' ' << r.nodes() << " (" << ( r.bytes() >> 10 ) << " kB";
+        if ( r.held() != r.bytes() )
+            os << ", " << ( r.held() >> 10 ) << " kB held";
+        os << ')' << endl;
+
+        totalNodes += r.nodes();
+        totalBytes += r.bytes();
+        totalHeld += r.held();
+    }
+
+    os << "memory [" << stage << "] : total " << totalNodes << " nodes and buffers (" << ( totalBytes >> 10 ) << " kB";
+    if ( totalHeld != totalBytes )
+        os << ", " << ( totalHeld >> 10 ) << " kB held: the arena does not reuse freed memory";
+    os << ')';
+    if ( data.arena )
+        os << ", arena chunks " << ( data.heap.bytes() >> 10 ) << " kB";
+    os << endl;
+
+    if ( top == 0 )
+        return;
+
+    vector< pair< size_t, AS > > weights;
+    weights.reserve( data.size() );
+
+    for ( unsigned int s = LINK_NODES; s < STRUCTURES; ++s )
+    {
+        const TaggedResource& r = data.structures[s];
+        const double nodeBytes = r.nodes() > 0 ? static_cast< double >( r.bytes() ) / r.nodes() : 0;
+        const bool buffers = s == CONE_BUFFERS; // Elements of vectors, bytes of their capacities
+
+        weights.clear();
+        for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+            weights.push_back( make_pair( elements( it->second, static_cast< Structure >( s ) ), it->first ) );
+
+        const size_t n = min< size_t >( top, weights.size() );
+        partial_sort( weights.begin(), weights.begin() + n, weights.end(), greater< pair< size_t, AS > >() );
+
+        os << "memory [" << stage << "] : heaviest for " << structureNames[s] << " :";
+        for ( size_t i = 0; i < n && weights[i].first != 0; ++i )
+        {
+            const ASData& d = data.at( weights[i].second );
+            const size_t bytes = buffers ? d.providers.capacity() * sizeof( AS ) + d.coneSketch.capacity() * sizeof( uint64_t ) : weights[i].first * nodeBytes;
+            os << ' ' << weights[i].second << " (" << weights[i].first << ", " << bytes / 1024 << " kB)";
+        }
+        os << endl;
+    }
+}
+
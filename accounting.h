@@ -0,0 +1,41 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include <string>
+#include <ostream>
+#include "data.h"
+
+/*
+ * Memory accounting of Data, per kind of structure (cf Structure in arena.h)
+ *
+ *      AS nodes        Data[x]
+ *      link nodes      Data[x][y]
+ *      triplet nodes   Data[x][y][z]
+ *      cone elements   customerCone and providerCone (nodes)
+ *      cone buffers    providers and coneSketch, with approximate cones (buffers of vectors)
+ *      transit pairs   transitPairs
+ *      VP visibility   visibilityAsVP
+ *
+ * Counts and bytes come from the counters of the tagged resources of Data: they are
+ * exact (bytes of the nodes and buffers in use, without the overhead of the arena or the
+ * heap) and read without traversing Data, in a few microseconds. An arena does not reuse
+ * what is deallocated (e.g. the buffers left by vectors growing): the bytes it still holds
+ * are reported as well when they differ.
+ *
+ * If top is not 0, Data is also traversed (reading container sizes, links included) to
+ * find the top ASs whose structures of each kind are the heaviest; their bytes are
+ * estimated from the mean node size of the kind, or are the capacities of buffers.
+ */
+
+void printMemoryReport( const Data& data, const string& stage, unsigned int top, ostream& os );
+
+#endif
+
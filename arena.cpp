@@ -0,0 +1,141 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "arena.h"
+#include <cstdint>
+
+const size_t chunkSize = 1<<16; // Size of the first chunk of a lane, next ones grow geometrically
+
+CountingResource::CountingResource() : allocations( 0 ), allocated( 0 ) {}
+
+void* CountingResource::do_allocate( size_t bytes, size_t alignment )
+{
+    allocations.fetch_add( 1, memory_order_relaxed );
+    allocated.fetch_add( bytes, memory_order_relaxed );
+    return pmr::new_delete_resource()->allocate( bytes, alignment );
+}
+
+void CountingResource::do_deallocate( void* p, size_t bytes, size_t alignment )
+{
+    pmr::new_delete_resource()->deallocate( p, bytes, alignment );
+}
+
+thread_local unsigned int Arena::current = 0;
+
+Arena::Lane::Lane( unsigned int lane ) : previous( current ) { current = lane; }
+Arena::Lane::~Lane() { current = previous; }
+
+Arena::Arena( pmr::memory_resource* up ) : upstream( up ) {}
+
+// Releases all the chunks at once
+Arena::~Arena()
+{
+    for ( unsigned int i = 0; i < lanes; ++i )
+        delete buffers[i].resource;
+}
+
+size_t Arena::calls() const
+{
+    size_t c = 0;
+    for ( unsigned int i = 0; i < lanes; ++i )
+        c += buffers[i].calls;
+    return c;
+}
+
+void* Arena::do_allocate( size_t bytes, size_t alignment )
+{
+    Buffer& buffer = buffers[current];
+
+    if ( buffer.resource == 0 )
+        buffer.resource = new pmr::monotonic_buffer_resource( chunkSize, upstream );
+
+    ++buffer.calls;
+    return buffer.resource->allocate( bytes, alignment );
+}
+
+// Helper structure
+// Family found by the last call of tagged on a thread, valid as long as generation has not changed
+struct FamilyCache
+{
+    TaggedResource* family;
+    unsigned long generation;
+};
+
+static thread_local FamilyCache lastFamily = { 0, 0 };
+static atomic< unsigned long > generation( 1 ); // Incremented when a TaggedResource is destroyed
+
+TaggedResource::TaggedResource() : upstream( pmr::new_delete_resource() ), family( this ), releases( true ) {}
+
+TaggedResource::~TaggedResource() { generation.fetch_add( 1, memory_order_relaxed ); }
+
+void TaggedResource::bind( pmr::memory_resource* up, TaggedResource* f, bool r )
+{
+    upstream = up;
+    family = f;
+    releases = r;
+}
+
+long TaggedResource::nodes() const
+{
+    long n = 0;
+    for ( unsigned int i = 0; i < Arena::lanes; ++i )
+        n += counters[i].nodes;
+    return n;
+}
+
+long TaggedResource::bytes() const
+{
+    long b = 0;
+    for ( unsigned int i = 0; i < Arena::lanes; ++i )
+        b += counters[i].bytes;
+    return b;
+}
+
+long TaggedResource::held() const
+{
+    long b = 0;
+    for ( unsigned int i = 0; i < Arena::lanes; ++i )
+        b += counters[i].bytes + counters[i].unreleased;
+    return b;
+}
+
+// A resource within the cached family is one of its members: the family is alive, since no TaggedResource was destroyed since it was cached
+pmr::memory_resource* TaggedResource::tagged( pmr::memory_resource* resource, Structure s )
+{
+    FamilyCache& cache = lastFamily;
+    const uintptr_t r = reinterpret_cast< uintptr_t >( resource ), f = reinterpret_cast< uintptr_t >( cache.family );
+
+    if ( r - f < STRUCTURES * sizeof( TaggedResource ) && cache.generation == generation.load( memory_order_relaxed ) )
+        return &cache.family[s];
+
+    TaggedResource* t = dynamic_cast< TaggedResource* >( resource );
+    if ( t == 0 )
+        return resource;
+
+    cache.family = t->family;
+    cache.generation = generation.load( memory_order_relaxed );
+    return &t->family[s];
+}
+
+void* TaggedResource::do_allocate( size_t bytes, size_t alignment )
+{
+    Counter& counter = counters[Arena::lane()];
+    ++counter.nodes;
+    counter.bytes += bytes;
+    return upstream->allocate( bytes, alignment );
+}
+
+void TaggedResource::do_deallocate( void* p, size_t bytes, size_t alignment )
+{
+    Counter& counter = counters[Arena::lane()];
+    --counter.nodes;
+    counter.bytes -= bytes;
+    if ( !releases )
+        counter.unreleased += bytes;
+    upstream->deallocate( p, bytes, alignment );
+}
@@ -0,0 +1,152 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <memory_resource>
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+/*
+ * Memory resources backing the containers of Data (cf data.h)
+ *
+ * CountingResource --> new/delete, counting calls and allocated bytes (thread-safe)
+ *
+ * Arena --> Monotonic memory of one Data instance
+ *
+ *      Memory is taken from the upstream resource in large chunks and is only
+ *      released when the Arena is destroyed: deallocation is a no-op.
+ *      The arena has several lanes, each with its own chunks; a thread allocates
+ *      from the lane it is bound to (cf Arena::Lane, lane 0 by default), so that
+ *      threads working on distinct parts of Data never share a lane.
+ *      All the allocators built on an Arena compare equal, whatever their lane.
+ *
+ * TaggedResource --> Allocations of one kind of structure of Data, forwarded upstream
+ *
+ *      Maintains the number of allocations in use (nodes, or buffers of vectors) and their bytes
+ *      for its kind of structure, so that memory can be accounted for without traversing Data
+ *      (cf accounting.h). Over an upstream that releases nothing (an Arena), deallocated bytes
+ *      are still held: they are counted apart (cf held). Counters are
+ *      kept per lane (cf Arena::Lane), hence not shared by threads allocating at once.
+ *      The resources of all kinds of a Data form a family (cf DataMemory in data.h): a
+ *      container finds the resource of its elements through its own (cf tagged). The last
+ *      family found by a thread is cached, so that tagged only casts when the resource
+ *      changes or a family has been destroyed since.
+ */
+
+class CountingResource : public pmr::memory_resource
+{
+public:
+    CountingResource();
+
+    size_t calls() const { return allocations.load( memory_order_relaxed ); }
+    size_t bytes() const { return allocated.load( memory_order_relaxed ); }
+
+private:
+    void* do_allocate( size_t bytes, size_t alignment );
+    void do_deallocate( void* p, size_t bytes, size_t alignment );
+    bool do_is_equal( const pmr::memory_resource& other ) const noexcept { return this == &other; }
+
+    atomic< size_t > allocations;
+    atomic< size_t > allocated;
+};
+
+class Arena : public pmr::memory_resource
+{
+public:
+    static const unsigned int lanes = 64;
+
+    // Binds the calling thread to a lane for its lifetime (lane < Arena::lanes)
+    // Two threads allocating at the same time from an Arena must be bound to distinct lanes
+    class Lane
+    {
+    public:
+        Lane( unsigned int lane );
+        ~Lane();
+
+    private:
+        unsigned int previous;
+    };
+
+    Arena( pmr::memory_resource* upstream );
+    ~Arena();
+
+    static unsigned int lane() { return current; } // Lane of the calling thread
+
+    size_t calls() const; // Allocations served by the arena
+
+private:
+    Arena( const Arena& );
+    Arena& operator=( const Arena& );
+
+    void* do_allocate( size_t bytes, size_t alignment );
+    void do_deallocate( void*, size_t, size_t ) {}
+    bool do_is_equal( const pmr::memory_resource& other ) const noexcept { return this == &other; }
+
+    // Chunks of a lane, created at its first allocation
+    struct alignas( 64 ) Buffer
+    {
+        Buffer() : resource( 0 ), calls( 0 ) {}
+
+        pmr::monotonic_buffer_resource* resource;
+        size_t calls;
+    };
+
+    static thread_local unsigned int current;
+
+    pmr::memory_resource* upstream;
+    Buffer buffers[lanes];
+};
+
+// CONE_ELEMENTS: nodes of exact cones, CONE_BUFFERS: buffers of the providers and sketches of approximate cones
+enum Structure { AS_NODES, LINK_NODES, TRIPLET_NODES, CONE_ELEMENTS, CONE_BUFFERS, TRANSIT_PAIRS, VP_VISIBILITY, STRUCTURES };
+
+class TaggedResource : public pmr::memory_resource
+{
+public:
+    TaggedResource();
+    ~TaggedResource();
+
+    // family[s] is the resource of Structure s; releases is false if deallocation does not return memory to upstream
+    void bind( pmr::memory_resource* upstream, TaggedResource* family, bool releases );
+
+    long nodes() const; // Allocations not deallocated
+    long bytes() const; // Of allocations not deallocated
+    long held() const; // Bytes taken from upstream and not released: bytes(), plus deallocated bytes if upstream does not release
+
+    // Resource of the structure s in the family of resource, or resource itself if it is not tagged
+    static pmr::memory_resource* tagged( pmr::memory_resource* resource, Structure s );
+
+private:
+    TaggedResource( const TaggedResource& );
+    TaggedResource& operator=( const TaggedResource& );
+
+    void* do_allocate( size_t bytes, size_t alignment );
+    void do_deallocate( void* p, size_t bytes, size_t alignment );
+    bool do_is_equal( const pmr::memory_resource& other ) const noexcept { return this == &other; }
+
+    struct alignas( 64 ) Counter
+    {
+        Counter() : nodes( 0 ), bytes( 0 ), unreleased( 0 ) {}
+
+        long nodes;
+        long bytes;
+        long unreleased;
+    };
+
+    pmr::memory_resource* upstream;
+    TaggedResource* family;
+    bool releases;
+    Counter counters[Arena::lanes];
+};
+
+#endif
+
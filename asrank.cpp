@@ -0,0 +1,232 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "asrank.h"
+#include "io.h"
+#include "inference.h"
+#include "sample.h"
+#include <stdexcept>
+
+LinkView::iterator::iterator( Data::const_iterator a, Data::const_iterator e ) : as( a ), end( e )
+{
+    if ( as != end )
+    {
+        neighbor = as->second.begin();
+        settle();
+    }
+}
+
+LinkView::iterator& LinkView::iterator::operator++()
+{
+    ++neighbor;
+    settle();
+    return *this;
+}
+
+void LinkView::iterator::settle()
+{
+    while ( as != end )
+    {
+        for ( ; neighbor != as->second.end(); ++neighbor )
+            if ( as->first < neighbor->first )
+            {
+                link.a = as->first;
+                link.b = neighbor->first;
+                link.relationship = neighbor->second.relationship;
+                return;
+            }
+
+        if ( ++as != end )
+            neighbor = as->second.begin();
+    }
+}
+
+ASRank::ASRank( const Options& options ) : opt( options ), cliqueGiven( false ), graph( 0 ) {}
+
+ASRank::~ASRank()
+{
+    delete graph;
+}
+
+void ASRank::addPathFile( const string& file )
+{
+    pathFiles.push_back( file );
+}
+
+void ASRank::addPath( const AS* path, size_t length )
+{
+    pathASes.insert( pathASes.end(), path, path + length );
+    pathEnds.push_back( pathASes.size() );
+}
+
+void ASRank::addPaths( const AS* ases, const size_t* ends, size_t count )
+{
+    size_t begin = 0;
+    for ( size_t i = 0; i < count; ++i )
+    {
+        addPath( ases + begin, ends[i] - begin );
+        begin = ends[i];
+    }
+}
+
+void ASRank::addRelationshipFile( const string& file )
+{
+    relFiles.push_back( file );
+}
+
+void ASRank::addIXPs( const set< AS >& ixp )
+{
+    ixpSet.insert( ixp.begin(), ixp.end() );
+}
+
+void ASRank::setClique( const set< AS >& clique )
+{
+    cliqueSet = clique;
+    cliqueGiven = true;
+}
+
+// Helper function
+// Loads path files then in-memory paths into data, with the given clique, from the sampled VPs if any
+void ASRank::loadInto( Data& data, const set< AS >& clique ) const
+{
+    vector< AS > asPath;
+
+    data.vantagePoints = vpSample.vantagePoints;
+    loadPaths( pathFiles, data, ixpSet, clique );
+
+    size_t begin = 0;
+    for ( size_t i = 0; i < pathEnds.size(); ++i )
+    {
+        if ( readPath( pathASes.data() + begin, pathEnds[i] - begin, asPath, ixpSet, clique ) )
+            if ( data.vantagePoints.empty() || data.vantagePoints.count( asPath[0] ) != 0 )
+                ::addPath( asPath, data );
+        begin = pathEnds[i];
+    }
+}
+
+// Samples VPs first if options().samplePercent or sampleFullPercent is below 100 (cf sample.h)
+// Computes the clique first if needed, on a temporary Data (cf computeClique)
+// observer, if any, is called once paths are loaded ("paths") and once Data is initialized ("initialization")
+void ASRank::load( const StageObserver& observer )
+{
+    if ( pathFiles.empty() && pathEnds.empty() )
+        throw runtime_error( "no path to load" );
+
+    vpSample = VantagePointSample();
+    if ( opt.samplePercent < 100 || opt.sampleFullPercent < 100 )
+    {
+        VantagePointSampler sampler( ixpSet );
+
+        for ( unsigned int i = 0; i < pathFiles.size(); ++i )
+            sampler.addFile( pathFiles[i] );
+
+        size_t begin = 0;
+        for ( size_t i = 0; i < pathEnds.size(); ++i )
+        {
+            sampler.addPath( pathASes.data() + begin, pathEnds[i] - begin );
+            begin = pathEnds[i];
+        }
+
+        vpSample = sampler.select( opt );
+        if ( vpSample.vantagePoints.empty() )
+            throw runtime_error( "no vantage point in sample" );
+    }
+
+    if ( !cliqueGiven )
+    {
+        Data data( opt );
+        loadInto( data, set< AS >() );
+        data.initialize( vector< string >(), set< AS >() );
+        cliqueSet = computeClique( data );
+    }
+
+    delete graph;
+    graph = 0;
+    graph = new Data( opt );
+
+    loadInto( *graph, cliqueSet );
+    if ( observer )
+        observer( "paths", *graph );
+
+    graph->initialize( relFiles, cliqueSet );
+    if ( observer )
+        observer( "initialization", *graph );
+}
+
+// Helper function
+// Starts the inference step stage: relationships set from now on are recorded as set by it (cf Data::evidence)
+inline void begin( Data& data, Stage stage )
+{
+    data.evidence.begin( stage );
+}
+
+// Helper function
+// Calls observer, if any, after the inference step stage
+inline void notify( const StageObserver& observer, Stage stage, const Data& data )
+{
+    if ( observer )
+        observer( stageNames[stage], data );
+}
+
+// observer, if any, is called after each step with its name
+void ASRank::infer( const StageObserver& observer )
+{
+    if ( graph == 0 )
+        throw runtime_error( "infer called before load" );
+
+    Data& data = *graph;
+
+    begin( data, ADD_UPSTREAM_PROVIDER_LINKS );
+    addUpstreamProviderLinks( data );
+    notify( observer, ADD_UPSTREAM_PROVIDER_LINKS, data );
+    begin( data, FIND_CLIENT_STUBS_SEEN_FROM_PARTIAL_VP );
+    findClientStubsSeenFromPartialVP( data );
+    notify( observer, FIND_CLIENT_STUBS_SEEN_FROM_PARTIAL_VP, data );
+    begin( data, ADD_LINKS_TO_SMALLER_PROVIDERS );
+    addLinksToSmallerProviders( data );
+    notify( observer, ADD_LINKS_TO_SMALLER_PROVIDERS, data );
+    begin( data, BREAK_TIES_WHEN_NO_PROVIDER );
+    breakTiesWhenNoProvider( data );
+    notify( observer, BREAK_TIES_WHEN_NO_PROVIDER, data );
+    begin( data, SET_CLIQUE_STUB_LINKS_AS_P2C );
+    setCliqueStubLinksAsP2C( data, cliqueSet );
+    notify( observer, SET_CLIQUE_STUB_LINKS_AS_P2C, data );
+    begin( data, BREAK_REMAINING_TIES );
+    breakRemainingTies( data );
+    notify( observer, BREAK_REMAINING_TIES, data );
+    begin( data, COMPLETE_WITH_P2P_LINKS );
+    completeWithP2PLinks( data );
+    notify( observer, COMPLETE_WITH_P2P_LINKS, data );
+}
+
+const Data& ASRank::data() const
+{
+    if ( graph == 0 )
+        throw logic_error( "data called before load" );
+
+    return *graph;
+}
+
+LinkView ASRank::links() const
+{
+    return LinkView( data() );
+}
+
+TypeOfRelationship ASRank::relationship( AS a, AS b ) const
+{
+    if ( graph == 0 )
+        return UNKNOWN;
+
+    Data::const_iterator it = graph->find( a );
+    if ( it == graph->end() )
+        return UNKNOWN;
+
+    ASData::const_iterator jt = it->second.find( b );
+    return jt != it->second.end() ? jt->second.relationship : UNKNOWN;
+}
+
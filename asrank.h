@@ -0,0 +1,122 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef ASRANK_H
+#define ASRANK_H
+
+#include <set>
+#include <vector>
+#include <string>
+#include <iterator>
+#include <functional>
+#include "data.h"
+#include "sample.h"
+
+/*
+ * libasrank --> Library interface of the AS ranking algorithm
+ *
+ *      ASRank engine( options );
+ *      engine.addPaths( ases, ends, count );   // and/or addPathFile, addRelationshipFile, addIXPs, setClique
+ *      engine.run();                           // load() then infer()
+ *      for ( LinkView::iterator it = engine.links().begin(); it != engine.links().end(); ++it )
+ *          ... it->a, it->b, it->relationship ...
+ *
+ * Paths given in memory are copied by addPath(s) (they are loaded twice when the clique
+ * has to be computed); files are read during load(). Inputs must be given before load().
+ *
+ * An ASRank instance owns all its data: independent instances may be used concurrently
+ * by different threads. A single instance must not be used by several threads at once,
+ * except for its const methods once infer() has returned.
+ */
+
+// Read-only view of the links of a Data, each link once (a < b), in increasing (a, b) order
+// Iterators refer to Data directly; they remain valid as long as the Data is not modified
+class LinkView
+{
+public:
+    class iterator
+    {
+    public:
+        typedef forward_iterator_tag iterator_category;
+        typedef Link value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Link* pointer;
+        typedef const Link& reference;
+
+        iterator( Data::const_iterator as, Data::const_iterator end );
+
+        reference operator*() const { return link; }
+        pointer operator->() const { return &link; }
+        iterator& operator++();
+        bool operator==( const iterator& other ) const { return as == other.as && ( as == end || neighbor == other.neighbor ); }
+        bool operator!=( const iterator& other ) const { return !( *this == other ); }
+
+    private:
+        void settle(); // Moves to the first link with a < b from the current position
+
+        Data::const_iterator as;
+        Data::const_iterator end;
+        ASData::const_iterator neighbor;
+        Link link;
+    };
+
+    LinkView( const Data& d ) : data( d ) {}
+
+    iterator begin() const { return iterator( data.begin(), data.end() ); }
+    iterator end() const { return iterator( data.end(), data.end() ); }
+
+private:
+    const Data& data;
+};
+
+typedef function< void( const string& stage, const Data& data ) > StageObserver;
+
+class ASRank
+{
+public:
+    ASRank( const Options& options = Options() );
+    ~ASRank();
+
+    void addPathFile( const string& file ); // Format detailed in io.h
+    void addPath( const AS* path, size_t length );
+    void addPaths( const AS* ases, const size_t* ends, size_t count ); // Path i is ases[ends[i-1]..ends[i]-1] (ends[-1] = 0)
+    void addRelationshipFile( const string& file );
+    void addIXPs( const set< AS >& ixp );
+    void setClique( const set< AS >& clique ); // Computed by load() if not set
+
+    void load( const StageObserver& observer = StageObserver() ); // Builds ("paths") and initializes ("initialization") Data
+    void infer( const StageObserver& observer = StageObserver() ); // Runs all the inference steps
+    void run() { load(); infer(); }
+
+    const Options& options() const { return opt; }
+    const set< AS >& clique() const { return cliqueSet; }
+    const VantagePointSample& sample() const { return vpSample; } // After load(), empty without sampling
+    const Data& data() const; // After load(), throws logic_error before
+    LinkView links() const; // After load(), throws logic_error before
+    TypeOfRelationship relationship( AS a, AS b ) const; // UNKNOWN if a and b are not linked, or before load()
+
+private:
+    ASRank( const ASRank& );
+    ASRank& operator=( const ASRank& );
+
+    void loadInto( Data& data, const set< AS >& clique ) const;
+
+    const Options opt;
+    vector< string > pathFiles;
+    vector< string > relFiles;
+    vector< AS > pathASes;
+    vector< size_t > pathEnds;
+    set< AS > ixpSet;
+    set< AS > cliqueSet;
+    bool cliqueGiven;
+    VantagePointSample vpSample;
+    Data* graph;
+};
+
+#endif
+
@@ -0,0 +1,33 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "bench.h"
+#include <fstream>
+#include <string>
+
+// Helper function
+// Reads a field of /proc/self/status (0 if not available)
+size_t procStatus( const string& field )
+{
+    ifstream fs( "/proc/self/status" );
+    string key;
+    size_t value;
+
+    while ( fs >> key )
+    {
+        if ( key == field )
+            return fs >> value ? value : 0;
+        fs.ignore( 1024, '\n' );
+    }
+
+    return 0;
+}
+
+size_t residentMemory() { return procStatus( "VmRSS:" ); }
+size_t peakResidentMemory() { return procStatus( "VmHWM:" ); }
+
@@ -0,0 +1,38 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+
+using namespace std;
+
+/*
+ * Measurements reported with --bench (on the standard error)
+ */
+
+// Wall-clock time since construction or last reset
+class Timer
+{
+public:
+    Timer() : start( chrono::steady_clock::now() ) {}
+
+    void reset() { start = chrono::steady_clock::now(); }
+    double seconds() const { return chrono::duration< double >( chrono::steady_clock::now() - start ).count(); }
+
+private:
+    chrono::steady_clock::time_point start;
+};
+
+size_t residentMemory(); // Current resident set size (kB)
+size_t peakResidentMemory(); // Peak resident set size (kB)
+
+#endif
+
@@ -0,0 +1,158 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "bench.h"
+
+using namespace std;
+
+/*
+ * asrank-client socket relationshipFile [connections [batches [batchSize]]]
+ *
+ * Load test of an asrank daemon (asrank --serve socket ...).
+ * Each connection sends batches of batchSize queries (rel, cone and size, in turn)
+ * about links drawn from relationshipFile (CAIDA format), and waits for all the
+ * answers of a batch before sending the next one.
+ * Reports the throughput and the p50/p99 latencies of batches on the standard output.
+ *
+ * Defaults: 4 connections, 1000 batches per connection, 100 queries per batch.
+ */
+
+typedef pair< unsigned int, unsigned int > Pair;
+
+// One connection: returns the latency of each batch (in seconds), empty on failure
+void run( const string& socketPath, const vector< Pair >& links, unsigned int seed, unsigned int batches, unsigned int batchSize, vector< double >* latencies )
+{
+    sockaddr_un address;
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    strncpy( address.sun_path, socketPath.c_str(), sizeof( address.sun_path ) - 1 );
+
+    const int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 || connect( fd, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0 )
+    {
+        cerr << "cannot connect to " << socketPath << endl;
+        return;
+    }
+
+    mt19937 random( seed );
+    vector< char > buffer( 1<<16 );
+
+    for ( unsigned int b = 0; b < batches; ++b )
+    {
+        ostringstream os;
+        for ( unsigned int q = 0; q < batchSize; ++q )
+        {
+            const Pair& l = links[random() % links.size()];
+            switch ( q % 3 )
+            {
+                case 0: os << "rel " << l.first << ' ' << l.second << '\n'; break;
+                case 1: os << "cone " << l.first << ' ' << l.second << '\n'; break;
+                default: os << "size " << l.first << '\n'; break;
+            }
+        }
+
+        const string query = os.str();
+        Timer timer;
+
+        if ( write( fd, query.data(), query.size() ) != static_cast< ssize_t >( query.size() ) )
+            break;
+
+        unsigned int answers = 0;
+        while ( answers < batchSize )
+        {
+            const ssize_t n = read( fd, &buffer[0], buffer.size() );
+            if ( n <= 0 )
+                break;
+            answers += count( buffer.begin(), buffer.begin() + n, '\n' );
+        }
+
+        if ( answers < batchSize )
+            break;
+
+        latencies->push_back( timer.seconds() );
+    }
+
+    close( fd );
+}
+
+int main( int argc, char** argv )
+{
+    if ( argc < 3 )
+    {
+        cerr << "Usage : asrank-client socket relationshipFile [connections [batches [batchSize]]]." << endl;
+        return 1;
+    }
+
+    const string socketPath( argv[1] );
+    const unsigned int connections = argc > 3 ? strtoul( argv[3], 0, 10 ) : 4;
+    const unsigned int batches = argc > 4 ? strtoul( argv[4], 0, 10 ) : 1000;
+    const unsigned int batchSize = argc > 5 ? strtoul( argv[5], 0, 10 ) : 100;
+
+    vector< Pair > links;
+    ifstream fs( argv[2] );
+    string line;
+
+    while ( getline( fs, line ) )
+    {
+        if ( line.empty() || line[0] == '#' )
+            continue;
+
+        istringstream is( line );
+        Pair l;
+        char separator;
+        if ( is >> l.first >> separator >> l.second )
+            links.push_back( l );
+    }
+
+    if ( links.empty() )
+    {
+        cerr << "no link in " << argv[2] << endl;
+        return 1;
+    }
+
+    vector< vector< double > > latencies( connections );
+    vector< thread > clients;
+    Timer timer;
+
+    for ( unsigned int i = 0; i < connections; ++i )
+        clients.push_back( thread( run, socketPath, cref( links ), i, batches, batchSize, &latencies[i] ) );
+
+    for ( unsigned int i = 0; i < connections; ++i )
+        clients[i].join();
+
+    const double elapsed = timer.seconds();
+    vector< double > all;
+
+    for ( unsigned int i = 0; i < connections; ++i )
+        all.insert( all.end(), latencies[i].begin(), latencies[i].end() );
+
+    if ( all.empty() )
+        return 1;
+
+    sort( all.begin(), all.end() );
+
+    cout << "batches : " << all.size() << " of " << batchSize << " queries in " << elapsed << " s" << endl;
+    cout << "throughput : " << all.size() * batchSize / elapsed << " queries/s" << endl;
+    cout << "batch latency : p50 " << all[all.size() / 2] * 1e3 << " ms, p99 " << all[all.size() * 99 / 100] * 1e3 << " ms" << endl;
+
+    return 0;
+}
+
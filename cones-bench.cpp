@@ -0,0 +1,139 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include "cones.h"
+#include "bench.h"
+
+using namespace std;
+
+/*
+ * asrank-cones-bench n [k] [--no-exact]
+ *
+ * Compares exact customer cones (sets, as ASData::customerCone) with bottom-k sketches
+ * (cf cones.h) on a synthetic hierarchy of n ASs: AS i has 1 to 3 providers amongst
+ * ASs 0..i-1, drawn with a bias towards the smallest (top) ones.
+ * Reports the time and memory used by both, and the relative errors of the sketches
+ * for cones of at least k ASs (smaller ones are exact).
+ *
+ * Defaults: k = 256. --no-exact only builds the sketches (for large n).
+ */
+
+typedef pair< uint32_t, uint32_t > Edge; // (provider, customer)
+
+// Helper function
+// Synthetic hierarchy, providers always have smaller identifiers than their customers
+void generate( size_t n, vector< Edge >& p2c )
+{
+    mt19937 random( 1 );
+
+    for ( size_t i = 1; i < n; ++i )
+    {
+        const unsigned int providers = 1 + random() % 3;
+        for ( unsigned int j = 0; j < providers; ++j )
+        {
+            const double u = uniform_real_distribution< double >( 0, 1 )( random );
+            const uint32_t p = static_cast< uint32_t >( i * u * u * u ); // Biased towards 0
+            if ( j == 0 || p2c.back().first != p )
+                p2c.push_back( Edge( p, i ) );
+        }
+    }
+}
+
+// Helper function
+// Exact cones, customers (larger identifiers) first
+void exactCones( size_t n, const vector< Edge >& p2c, vector< pmr::set< uint32_t > >& cones )
+{
+    vector< vector< uint32_t > > customers( n );
+    for ( size_t i = 0; i < p2c.size(); ++i )
+        customers[p2c[i].first].push_back( p2c[i].second );
+
+    cones.resize( n );
+    for ( size_t i = n; i-- > 0; )
+    {
+        cones[i].insert( i );
+        for ( size_t j = 0; j < customers[i].size(); ++j )
+            cones[i].insert( cones[customers[i][j]].begin(), cones[customers[i][j]].end() );
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t n = 0;
+    unsigned int k = 256;
+    bool exact = true;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        const string arg( argv[i] );
+
+        if ( arg == "--no-exact" )
+            exact = false;
+        else if ( n == 0 )
+            n = strtoul( argv[i], 0, 10 );
+        else
+            k = strtoul( argv[i], 0, 10 );
+    }
+
+    if ( n == 0 )
+    {
+        cerr << "Usage : asrank-cones-bench n [k] [--no-exact]" << endl;
+        return 1;
+    }
+
+    vector< Edge > p2c;
+    generate( n, p2c );
+    cout << n << " ASs, " << p2c.size() << " P2C links, k = " << k << endl;
+
+    Timer timer;
+    size_t memory = residentMemory();
+
+    ConeSketches sketches( n, p2c, k );
+
+    cout << "sketches : " << timer.seconds() << " s, " << sketches.memory() / 1024 << " kB ("
+         << residentMemory() - memory << " kB resident)" << endl;
+
+    if ( !exact )
+        return 0;
+
+    timer.reset();
+    memory = residentMemory();
+
+    vector< pmr::set< uint32_t > > cones;
+    exactCones( n, p2c, cones );
+
+    size_t members = 0;
+    for ( size_t i = 0; i < n; ++i )
+        members += cones[i].size();
+
+    cout << "exact : " << timer.seconds() << " s, " << members << " members ("
+         << residentMemory() - memory << " kB resident)" << endl;
+
+    double sum = 0, worst = 0;
+    size_t large = 0;
+
+    for ( size_t i = 0; i < n; ++i )
+        if ( cones[i].size() >= k )
+        {
+            const double error = fabs( sketches.size( i ) - cones[i].size() ) / cones[i].size();
+            sum += error;
+            worst = max( worst, error );
+            ++large;
+        }
+
+    cout << large << " cones of at least " << k << " ASs : mean relative error " << ( large ? sum / large : 0 )
+         << ", max " << worst << " (standard error bound " << ConeSketches::relativeError( k ) << ")" << endl;
+
+    return 0;
+}
+
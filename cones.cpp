@@ -0,0 +1,257 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "cones.h"
+#include "parallel.h"
+#include <algorithm>
+
+// Sketches of the customer cones of data (cf cones.h for the links followed)
+// Those kept by data (ASData::coneSketch) are copied if they have k hashes
+ConeSketches::ConeSketches( const Data& data, unsigned int size ) : k( max( size, 3u ) ), n( data.size() )
+{
+    vector< pair< uint32_t, uint32_t > > p2c;
+
+    ases.reserve( n );
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        ases.push_back( it->first );
+
+    if ( data.conesInitialized && data.options.approximateCones != 0 && max( data.options.approximateCones, 3u ) == k )
+    {
+        for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        {
+            starts.push_back( hashes.size() );
+            lengths.push_back( it->second.coneSketch.size() );
+            hashes.insert( hashes.end(), it->second.coneSketch.begin(), it->second.coneSketch.end() );
+        }
+        return;
+    }
+
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        for ( ASData::const_iterator jt = it->second.begin(); jt != it->second.end(); ++jt )
+            if ( jt->second.relationship == P2C && jt->second.inCones )
+                p2c.push_back( make_pair( id( it->first ), id( jt->first ) ) );
+
+    build( n, p2c );
+}
+
+ConeSketches::ConeSketches( size_t count, const vector< pair< uint32_t, uint32_t > >& p2c, unsigned int size ) : k( max( size, 3u ) ), n( count )
+{
+    build( n, p2c );
+}
+
+// Merges sketches customers first (topological order of the P2C links), then the members of cycles if any
+void ConeSketches::build( size_t count, const vector< pair< uint32_t, uint32_t > >& p2c )
+{
+    vector< uint64_t > customerStart( count + 1, 0 ), providerStart( count + 1, 0 );
+    vector< uint32_t > customers( p2c.size() ), providers( p2c.size() );
+
+    for ( size_t i = 0; i < p2c.size(); ++i )
+    {
+        ++customerStart[p2c[i].first + 1];
+        ++providerStart[p2c[i].second + 1];
+    }
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        customerStart[i+1] += customerStart[i];
+        providerStart[i+1] += providerStart[i];
+    }
+
+    {
+        vector< uint64_t > c( customerStart.begin(), customerStart.end() - 1 ), p( providerStart.begin(), providerStart.end() - 1 );
+        for ( size_t i = 0; i < p2c.size(); ++i )
+        {
+            customers[c[p2c[i].first]++] = p2c[i].second;
+            providers[p[p2c[i].second]++] = p2c[i].first;
+        }
+    }
+
+    vector< uint32_t > pending( count ); // Customers not merged yet
+    vector< uint32_t > order;
+    vector< bool > done( count, false );
+
+    order.reserve( count );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        pending[i] = customerStart[i+1] - customerStart[i];
+        if ( pending[i] == 0 )
+            order.push_back( i );
+    }
+
+    starts.assign( count, 0 );
+    lengths.assign( count, 0 );
+
+    vector< uint64_t > merged;
+    size_t first = 0; // No member before first is left to merge
+
+    for ( size_t next = 0; order.size() < count || next < order.size(); ++next )
+    {
+        if ( next == order.size() ) // Cycle: first member not merged yet
+        {
+            while ( done[first] )
+                ++first;
+            order.push_back( first );
+        }
+
+        const uint32_t x = order[next];
+
+        merged.assign( 1, hash64( ases.empty() ? x : ases[x] ) );
+        for ( uint64_t j = customerStart[x]; j < customerStart[x+1]; ++j )
+        {
+            const uint32_t c = customers[j];
+            if ( done[c] )
+                merged.insert( merged.end(), hashes.begin() + starts[c], hashes.begin() + starts[c] + lengths[c] );
+        }
+
+        sort( merged.begin(), merged.end() );
+        merged.erase( unique( merged.begin(), merged.end() ), merged.end() );
+        if ( merged.size() > k )
+            merged.resize( k );
+
+        starts[x] = hashes.size();
+        lengths[x] = merged.size();
+        hashes.insert( hashes.end(), merged.begin(), merged.end() );
+        done[x] = true;
+
+        for ( uint64_t j = providerStart[x]; j < providerStart[x+1]; ++j )
+            if ( --pending[providers[j]] == 0 && !done[providers[j]] )
+                order.push_back( providers[j] );
+    }
+}
+
+size_t ConeSketches::id( AS x ) const
+{
+    if ( ases.empty() )
+        return x < n ? x : n;
+
+    vector< AS >::const_iterator it = lower_bound( ases.begin(), ases.end(), x );
+    return it != ases.end() && *it == x ? it - ases.begin() : n;
+}
+
+double ConeSketches::estimate( const uint64_t* sketch, size_t length ) const
+{
+    if ( length < k )
+        return length; // Exact
+
+    return ( k - 1 ) / ( ( sketch[k-1] + 1.0 ) / 18446744073709551616.0 );
+}
+
+double ConeSketches::size( AS x ) const
+{
+    const size_t i = id( x );
+    return i == n ? 0 : estimate( &hashes[starts[i]], lengths[i] );
+}
+
+double ConeSketches::overlap( AS x, AS y ) const
+{
+    const size_t i = id( x ), j = id( y );
+    if ( i == n || j == n )
+        return 0;
+
+    const uint64_t* a = &hashes[starts[i]];
+    const uint64_t* b = &hashes[starts[j]];
+    const uint64_t* const aEnd = a + lengths[i];
+    const uint64_t* const bEnd = b + lengths[j];
+    vector< uint64_t > united; // k smallest hashes of the union
+    size_t both = 0;
+
+    while ( united.size() < k && ( a != aEnd || b != bEnd ) )
+    {
+        if ( b == bEnd || ( a != aEnd && *a < *b ) )
+            united.push_back( *a++ );
+        else if ( a == aEnd || *b < *a )
+            united.push_back( *b++ );
+        else
+        {
+            united.push_back( *a++ );
+            ++b;
+            ++both;
+        }
+    }
+
+    // Sketches shorter than k hold whole cones: the union is then exact unless truncated
+    const bool exact = lengths[i] < k && lengths[j] < k && a == aEnd && b == bEnd;
+    const double unionSize = exact ? united.size() : estimate( &united[0], united.size() );
+
+    return unionSize * both / united.size();
+}
+
+size_t ConeSketches::memory() const
+{
+    return hashes.size() * sizeof( uint64_t ) + starts.size() * sizeof( uint64_t ) + lengths.size() * sizeof( uint32_t );
+}
+
+// Helper function
+// Prefix cone of one AS: prefixes of the members of its customer cone, sorted, then their union
+void computePrefixCone( const Data& data, Data::const_iterator x, vector< AS >& members, vector< pair< uint32_t, unsigned char > >& prefixes, PrefixCone& cone )
+{
+    if ( data.options.approximateCones != 0 )
+        customerConeFromLinks( data, x->first, members );
+    else
+        members.assign( x->second.customerCone.begin(), x->second.customerCone.end() );
+
+    prefixes.clear();
+    for ( vector< AS >::const_iterator it = members.begin(); it != members.end(); ++it )
+    {
+        const PrefixTable::Entry* end;
+        for ( const PrefixTable::Entry* e = data.prefixes.prefixes( *it, end ); e != end; ++e )
+            prefixes.push_back( make_pair( e->network, e->length ) );
+    }
+
+    sort( prefixes.begin(), prefixes.end() );
+    prefixes.erase( unique( prefixes.begin(), prefixes.end() ), prefixes.end() );
+
+    // Prefixes are aligned: sorted by network then length, a prefix overlapping a previous one is within it
+    uint64_t covered = 0;
+    cone.prefixes = prefixes.size();
+    cone.addresses = 0;
+
+    for ( size_t i = 0; i < prefixes.size(); ++i )
+    {
+        const uint64_t size = uint64_t( 1 ) << ( 32 - prefixes[i].second );
+        if ( prefixes[i].first >= covered )
+        {
+            cone.addresses += size;
+            covered = prefixes[i].first + size;
+        }
+    }
+}
+
+// Helper functor
+// Thread t computes the prefix cones of ASs t, t + n, t + 2n... (large cones are spread over threads)
+struct ComputePrefixCones
+{
+    ComputePrefixCones( const Data& d, const vector< Data::const_iterator >& a, vector< PrefixCone >& c, unsigned int n ) : data( d ), ases( a ), cones( c ), threads( n ) {}
+    const Data& data;
+    const vector< Data::const_iterator >& ases;
+    vector< PrefixCone >& cones;
+    const unsigned int threads;
+
+    void operator()( unsigned int t ) const
+    {
+        vector< AS > members;
+        vector< pair< uint32_t, unsigned char > > prefixes;
+
+        for ( size_t i = t; i < ases.size(); i += threads )
+            computePrefixCone( data, ases[i], members, prefixes, cones[i] );
+    }
+};
+
+void computePrefixCones( const Data& data, vector< PrefixCone >& cones, unsigned int threads )
+{
+    vector< Data::const_iterator > ases;
+
+    ases.reserve( data.size() );
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        ases.push_back( it );
+
+    cones.assign( ases.size(), PrefixCone() );
+    threads = min( max( 1u, threads ), Arena::lanes );
+
+    parallel( threads, ComputePrefixCones( data, ases, cones, threads ) );
+}
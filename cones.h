@@ -0,0 +1,102 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef CONES_H
+#define CONES_H
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include "data.h"
+
+/*
+ * ConeSketches --> Approximate customer cones (bottom-k sketches)
+ *
+ *      Each AS x gets a 64 bit hash h(x). The sketch of a cone is the set of the k
+ *      smallest hashes of its members. Sketches are merged bottom-up over the P2C
+ *      links (customers before providers): the sketch of x keeps the k smallest
+ *      hashes amongst h(x) and the sketches of its customers.
+ *      Memory is 8 * min( k, cone size ) bytes per AS, instead of one set node per member.
+ *
+ * Size estimate
+ *
+ *      A cone of less than k members is known exactly. Otherwise, if u is the k-th
+ *      smallest hash divided by 2^64, the size is estimated as (k-1)/u. This estimator
+ *      is unbiased and its relative standard error is at most 1/sqrt(k-2)
+ *      (k = 256: 6.3%, k = 1024: 3.1%); errors above 3 standard errors are rare.
+ *
+ * Overlap estimate
+ *
+ *      For cones A and B, the k smallest hashes of A u B are taken from both sketches;
+ *      the fraction of them present in both sketches estimates the Jaccard index J,
+ *      and |A n B| is estimated as J * |A u B|. Its error grows as J gets smaller.
+ *
+ * Only P2C links reflected in cones (LinkData::inCones) are followed, so sketches
+ * estimate the same cones as ASData::customerCone. If links form a cycle, the
+ * members of the cycle are merged in AS order and their sketches may miss members.
+ *
+ * With approximate cones, Data keeps the sketch of each AS up to date during inference
+ * (ASData::coneSketch, cf Data::addToConeSketches), instead of exact customer and provider
+ * cones. ConeSketches built from such a Data copies them.
+ */
+
+// 64 bit mix of an AS number or identifier (splitmix64 finalizer)
+inline uint64_t hash64( uint64_t x )
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+    x = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBull;
+    return x ^ ( x >> 31 );
+}
+
+/*
+ * PrefixCone --> Prefixes originated in the customer cone of an AS (cf Data::prefixes)
+ *
+ *      prefixes (integer) [distinct prefixes, whatever the ASs originating them]
+ *      addresses (integer) [IPv4 addresses covered by these prefixes, counted once where they overlap]
+ */
+
+struct PrefixCone
+{
+    PrefixCone() : prefixes( 0 ), addresses( 0 ) {}
+
+    size_t prefixes;
+    uint64_t addresses;
+};
+
+// Prefix cones of all the ASs of data, in the order of data, computed by threads threads (at most Arena::lanes, cf parallel.h)
+// With approximate cones, customer cones are found through the links (cf customerConeFromLinks)
+void computePrefixCones( const Data& data, vector< PrefixCone >& cones, unsigned int threads );
+
+class ConeSketches
+{
+public:
+    ConeSketches( const Data& data, unsigned int k );
+    ConeSketches( size_t n, const vector< pair< uint32_t, uint32_t > >& p2c, unsigned int k ); // Identifiers 0..n-1, (provider, customer) links
+
+    double size( AS x ) const; // Estimated customer cone size (0 if x is unknown)
+    double overlap( AS x, AS y ) const; // Estimated number of ASs in both customer cones
+    size_t memory() const; // Bytes used by the sketches
+
+    static double relativeError( unsigned int k ) { return k > 2 ? 1 / sqrt( k - 2.0 ) : 1; }
+
+private:
+    void build( size_t n, const vector< pair< uint32_t, uint32_t > >& p2c );
+    double estimate( const uint64_t* sketch, size_t length ) const;
+    size_t id( AS x ) const; // n if unknown
+
+    const unsigned int k;
+    size_t n;
+    vector< AS > ases; // AS of each identifier, empty if built from identifiers
+    vector< uint64_t > starts; // Sketch of i is hashes[starts[i]..starts[i]+lengths[i]-1], sorted
+    vector< uint32_t > lengths;
+    vector< uint64_t > hashes;
+};
+
+#endif
+
@@ -7,13 +7,41 @@
 */
 
 #include "data.h"
+#include "cones.h"
 #include "io.h"
+#include "parallel.h"
 #include <algorithm>
+#include <iterator>
+#include <new>
 
 // 0-initialization of data structures
+Options::Options() : spillBuffer( 0 ), threads( 1 ), useArena( true ),
+    cliqueCandidates( 10 ), peerTripletCount( 2 ), partialVPRatio( 50 ), smallerProviderCount( 2 ), noProviderTransitDegree( 10 ),
+    approximateCones( 0 ), samplePercent( 100 ), sampleFullPercent( 100 ), recordEvidence( false ) {}
+
 TripletData::TripletData() : upstream( false ), endOfPath( false ), twoEdgePath( false ), count( 0 ) {}
-LinkData::LinkData() : transit( false ), relationship( UNKNOWN ) {}
-ASData::ASData() : rank( 0 ), inClique( false ) {}
+// Containers take the resource of their kind of structure in the family of the allocator (cf TaggedResource in arena.h)
+LinkData::LinkData( const allocator_type& a ) : pmr::map< AS, TripletData >( TaggedResource::tagged( a.resource(), TRIPLET_NODES ) ),
+    transit( false ), inCones( false ), relationship( UNKNOWN ) {}
+ASData::ASData( const allocator_type& a ) : pmr::map< AS, LinkData >( TaggedResource::tagged( a.resource(), LINK_NODES ) ),
+    customerCone( TaggedResource::tagged( a.resource(), CONE_ELEMENTS ) ), providerCone( TaggedResource::tagged( a.resource(), CONE_ELEMENTS ) ),
+    visibilityAsVP( TaggedResource::tagged( a.resource(), VP_VISIBILITY ) ), transitPairs( TaggedResource::tagged( a.resource(), TRANSIT_PAIRS ) ),
+    providers( TaggedResource::tagged( a.resource(), CONE_BUFFERS ) ), coneSketch( TaggedResource::tagged( a.resource(), CONE_BUFFERS ) ), rank( 0 ), inClique( false ) {}
+
+// Copies into another memory resource
+LinkData::LinkData( const LinkData& l, const allocator_type& a ) : pmr::map< AS, TripletData >( l, TaggedResource::tagged( a.resource(), TRIPLET_NODES ) ),
+    transit( l.transit ), inCones( l.inCones ), relationship( l.relationship ) {}
+ASData::ASData( const ASData& d, const allocator_type& a ) : pmr::map< AS, LinkData >( d, TaggedResource::tagged( a.resource(), LINK_NODES ) ),
+    customerCone( d.customerCone, TaggedResource::tagged( a.resource(), CONE_ELEMENTS ) ), providerCone( d.providerCone, TaggedResource::tagged( a.resource(), CONE_ELEMENTS ) ),
+    visibilityAsVP( d.visibilityAsVP, TaggedResource::tagged( a.resource(), VP_VISIBILITY ) ), transitPairs( d.transitPairs, TaggedResource::tagged( a.resource(), TRANSIT_PAIRS ) ),
+    providers( d.providers, TaggedResource::tagged( a.resource(), CONE_BUFFERS ) ), coneSketch( d.coneSketch, TaggedResource::tagged( a.resource(), CONE_BUFFERS ) ), transitDegree( d.transitDegree ), rank( d.rank ), inClique( d.inClique ) {}
+
+DataMemory::DataMemory( bool useArena ) : arena( useArena ? new Arena( &heap ) : 0 ), resource( useArena ? static_cast< pmr::memory_resource* >( arena ) : &heap )
+{
+    for ( unsigned int s = 0; s < STRUCTURES; ++s )
+        structures[s].bind( resource, structures, !useArena );
+}
+DataMemory::~DataMemory() { delete arena; }
 
 // Helper function
 // Called once, at initialization of data
@@ -31,88 +59,232 @@ inline void setClique( Data& data, const set< AS >& clique )
 }
 
 // Helper function
-// Required for count_if in function computeTransitDegrees
-bool transitPredicate( const pair< AS, LinkData >& l ) { return l.second.transit; }
+// Required for count_if in InitializeASs
+bool transitPredicate( const pair< const AS, LinkData >& l ) { return l.second.transit; }
 
-// Helper function
-// Called once, at initialization of data
-// Computes the transit degrees of all the ASs in data
-// Initializes ASData::transitDegree
-inline void computeTransitDegrees( Data& data )
+// Helper structure
+// Rank key of an AS, flat copy of the fields it is ranked on
+// Clique ASs first, then by decreasing transit degree, decreasing degree, and increasing AS number
+struct RankKey
 {
-    for ( Data::iterator it = data.begin(); it != data.end(); ++it )
-        it->second.transitDegree = count_if( it->second.begin(), it->second.end(), transitPredicate );
-}
+    bool inClique;
+    unsigned int transitDegree;
+    size_t degree;
+    AS as;
+    ASData* data;
+
+    bool operator<( const RankKey& k ) const
+    {
+        if ( inClique != k.inClique )
+            return inClique;
+
+        if ( transitDegree != k.transitDegree )
+            return transitDegree > k.transitDegree;
+
+        if ( degree != k.degree )
+            return degree > k.degree;
+
+        return as < k.as;
+    }
+};
 
 // Helper functor
-// Required for sort in function computeASRanks
-struct Comparator
+// Called once, at initialization of data, by thread t for ASs t, t + n, t + 2n...
+// Initializes ASData::transitDegree (transit degree as defined by CAIDA) and the rank key of each AS
+// Seeds the cones of each AS with itself
+struct InitializeASs
 {
-    Comparator ( const Data& data ) : d( data ) {}
-    const Data& d;
+    InitializeASs( vector< RankKey >& k, bool c, unsigned int n ) : keys( k ), exactCones( c ), threads( n ) {}
+    vector< RankKey >& keys;
+    const bool exactCones;
+    const unsigned int threads;
 
-    bool operator()( AS a, AS b ) const // a < b ?
+    void operator()( unsigned int t ) const
     {
-        const ASData& dA = d.at( a );
-        const ASData& dB = d.at( b );
-
-        if ( dA.inClique != dB.inClique )
-            return dA.inClique;
-
-        if ( dA.transitDegree != dB.transitDegree )
-            return dA.transitDegree > dB.transitDegree;
+        for ( size_t i = t; i < keys.size(); i += threads )
+        {
+            RankKey& k = keys[i];
+            ASData& d = *k.data;
 
-        if ( dA.size() != dB.size() )
-            return dA.size() > dB.size();
+            d.transitDegree = count_if( d.begin(), d.end(), transitPredicate );
+            k.inClique = d.inClique;
+            k.transitDegree = d.transitDegree;
+            k.degree = d.size();
 
-        return a < b;
+            if ( exactCones )
+            {
+                d.customerCone.insert( k.as );
+                d.providerCone.insert( k.as );
+            }
+            else
+                d.coneSketch.assign( 1, hash64( k.as ) );
+        }
     }
 };
 
-// Helper function
-// Called once, at initialization of data
-// Computes AS ranking and fills in asByRank
+// Helper functor
+// Called once, at initialization of data, by thread t for ranks t+1, t+1 + n, t+1 + 2n... once keys are sorted
 // Initializes Data::asByRank and ASData::rank
-inline void computeASRanks( Data& data )
+struct AssignRanks
 {
-    Comparator comp( data );
+    AssignRanks( const vector< RankKey >& k, vector< AS >& a, unsigned int n ) : keys( k ), asByRank( a ), threads( n ) {}
+    const vector< RankKey >& keys;
+    vector< AS >& asByRank;
+    const unsigned int threads;
 
-    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
-        data.asByRank.push_back( it->first );
-    
-    sort( data.asByRank.begin(), data.asByRank.end(), comp );
+    void operator()( unsigned int t ) const
+    {
+        for ( size_t i = t; i < keys.size(); i += threads )
+        {
+            asByRank[i] = keys[i].as;
+            keys[i].data->rank = i+1;
+        }
+    }
+};
 
-    for ( unsigned int i = 0; i < data.asByRank.size(); ++i )
-        data[data.asByRank[i]].rank = i+1;
-}
+// Empty Data constructor
+// Paths should be added (cf loadPaths and addPath in io.h) before calling initialize
+Data::Data( const Options& o ) : DataMemory( o.useArena ), pmr::map< AS, ASData >( &structures[AS_NODES] ), options( o ), conesInitialized( false ) {}
 
 // Data constructor
 // Loads paths into Data, then intializes all required fields
 // All arguments can be empty except dataFiles, which should contain at least one file name
-Data::Data( const vector< string >& dataFiles, const vector< string >& relFile, const set< AS >& ixp, const set< AS >& clique )
+Data::Data( const vector< string >& dataFiles, const vector< string >& relFile, const set< AS >& ixp, const set< AS >& clique, const Options& o )
+    : DataMemory( o.useArena ), pmr::map< AS, ASData >( &structures[AS_NODES] ), options( o ), conesInitialized( false )
 {
     loadPaths ( dataFiles, *this, ixp, clique );
-    
+    initialize( relFile, clique );
+}
+
+// Data destructor
+// With an arena, the maps are moved in constant time to storage that is never destroyed, so that
+// their nodes are not visited: they only hold memory of the arena, released at once by ~DataMemory
+Data::~Data()
+{
+    if ( arena != 0 )
+        swap( *new ( released ) pmr::map< AS, ASData >( get_allocator() ) );
+}
+
+// Intializes all required fields once paths are loaded
+// relFile can be empty
+// Transit degrees, ranks and cones are initialized by options.threads threads (cf parallel.h)
+void Data::initialize( const vector< string >& relFile, const set< AS >& clique )
+{
+    evidence.begin( RELATIONSHIP_FILES );
     if ( !relFile.empty() )
         loadRelationships( relFile, *this );
 
+    evidence.begin( CLIQUE );
     setClique( *this, clique );
-    computeTransitDegrees( *this );
-    computeASRanks( *this );
 
-    for ( iterator it = begin(); it != end(); ++it )
+    const unsigned int threads = max( 1u, min( options.threads, Arena::lanes ) );
+    vector< RankKey > keys( size() );
+
+    size_t i = 0;
+    for ( iterator it = begin(); it != end(); ++it, ++i )
+    {
+        keys[i].as = it->first;
+        keys[i].data = &it->second;
+    }
+
+    parallel( threads, InitializeASs( keys, options.approximateCones == 0, threads ) );
+    parallelSort( keys, threads );
+
+    asByRank.resize( keys.size() );
+    parallel( threads, AssignRanks( keys, asByRank, threads ) );
+
+    conesInitialized = true;
+}
+
+// Customer cone of b computed from the links, used when customer cones are not kept (approximate cones)
+// Only P2C links set once cones were initialized are followed, as in exact customer cones
+void customerConeFromLinks( const Data& data, AS b, vector< AS >& cone )
+{
+    set< AS > visited;
+    size_t next = 0;
+
+    cone.assign( 1, b );
+    visited.insert( b );
+
+    while ( next < cone.size() )
+    {
+        const ASData& dX = data.at( cone[next++] );
+        for ( ASData::const_iterator it = dX.begin(); it != dX.end(); ++it )
+            if ( it->second.relationship == P2C && it->second.inCones && visited.insert( it->first ).second )
+                cone.push_back( it->first );
+    }
+}
+
+// Provider cone of a computed from the links (ASData::providers), used when provider cones are not kept (approximate cones)
+// Provider cones are small: the ASs reached are searched linearly
+void providerConeFromLinks( const Data& data, AS a, vector< AS >& cone )
+{
+    cone.assign( 1, a );
+
+    for ( size_t next = 0; next < cone.size(); ++next )
+    {
+        const pmr::vector< AS >& providers = data.at( cone[next] ).providers;
+        for ( pmr::vector< AS >::const_iterator it = providers.begin(); it != providers.end(); ++it )
+            if ( find( cone.begin(), cone.end(), *it ) == cone.end() )
+                cone.push_back( *it );
+    }
+}
+
+const size_t smallSketch = 16; // Sketches of at most this size are merged by insertion
+
+// Merges the sketch of b into the sketches of the ASs of cone (cf cones.h), the provider cone of a new provider of b
+// b should not be in cone (its sketch is read while the others are updated)
+void Data::addToConeSketches( const vector< AS >& cone, AS b )
+{
+    const size_t k = max( options.approximateCones, 3u );
+    const pmr::vector< uint64_t >& added = at( b ).coneSketch;
+    vector< uint64_t > merged;
+
+    for ( vector< AS >::const_iterator it = cone.begin(); it != cone.end(); ++it )
     {
-        it->second.customerCone.insert( it->first );
-        it->second.providerCone.insert( it->first );
+        pmr::vector< uint64_t >& sketch = at( *it ).coneSketch;
+
+        if ( added.size() <= smallSketch ) // Inserted in place
+        {
+            for ( pmr::vector< uint64_t >::const_iterator ht = added.begin(); ht != added.end(); ++ht )
+            {
+                if ( sketch.size() == k && *ht >= sketch.back() )
+                    break; // Full and only larger hashes left
+
+                const size_t i = std::lower_bound( sketch.begin(), sketch.end(), *ht ) - sketch.begin();
+                if ( i < sketch.size() && sketch[i] == *ht )
+                    continue;
+
+                if ( sketch.size() == k )
+                    sketch.pop_back();
+                else if ( sketch.size() == sketch.capacity() ) // Geometric growth, since the memory of an arena is not reused
+                    sketch.reserve( min( k, 2 * sketch.capacity() ) );
+                sketch.insert( sketch.begin() + i, *ht );
+            }
+            continue;
+        }
+
+        if ( sketch.size() == k && added.front() > sketch.back() )
+            continue; // Full and only larger hashes added
+
+        merged.clear();
+        set_union( sketch.begin(), sketch.end(), added.begin(), added.end(), back_inserter( merged ) );
+        if ( merged.size() > k )
+            merged.resize( k );
+
+        if ( merged.size() > sketch.capacity() )
+            sketch.reserve( min( k, max( merged.size(), 2 * sketch.capacity() ) ) );
+        sketch.assign( merged.begin(), merged.end() );
     }
 }
 
 // Sets relationship value
 // Should always be called when setting a relationship
 // When called after Data initialization, both a and b should already exist in Data
-// Updates provider/customer cones
+// Updates provider/customer cones, or cone sketches with approximate cones
+// Records the assignment and trigger in evidence, if options.recordEvidence
 // Returns false if assignment not possible (already assigned or would create a loop)
-bool Data::setRelationship( AS a, AS b, TypeOfRelationship t )
+bool Data::setRelationship( AS a, AS b, TypeOfRelationship t, AS trigger )
 {
     Data& data = *this;
 
@@ -123,6 +295,9 @@ bool Data::setRelationship( AS a, AS b, TypeOfRelationship t )
     {
         data[a][b].relationship = t;
         data[b][a].relationship = t;
+
+        if ( options.recordEvidence )
+            evidence.record( a, b, t, trigger );
     }
     else
     {
@@ -133,16 +308,40 @@ bool Data::setRelationship( AS a, AS b, TypeOfRelationship t )
             b = tmp;
         }
 
-        if ( data[a].providerCone.count( b ) != 0 )
+        vector< AS > providers; // Provider cone of a, with approximate cones
+        if ( conesInitialized && options.approximateCones != 0 )
+        {
+            providerConeFromLinks( data, a, providers );
+
+            if ( std::find( providers.begin(), providers.end(), b ) != providers.end() )
+                return false;
+        }
+        else if ( data[a].providerCone.count( b ) != 0 )
             return false;
 
         data[a][b].relationship = P2C;
         data[b][a].relationship = C2P;
 
-        for ( set< AS >::iterator it = data[a].providerCone.begin(); it != data[a].providerCone.end(); ++it )
+        if ( options.recordEvidence )
+            evidence.record( a, b, P2C, trigger );
+
+        if ( !conesInitialized )
+            return true; // Cones are empty
+
+        data[a][b].inCones = true;
+        data[b][a].inCones = true;
+
+        if ( options.approximateCones != 0 )
+        {
+            data[b].providers.push_back( a );
+            addToConeSketches( providers, b );
+            return true;
+        }
+
+        for ( pmr::set< AS >::iterator it = data[a].providerCone.begin(); it != data[a].providerCone.end(); ++it )
             data[*it].customerCone.insert( data[b].customerCone.begin(), data[b].customerCone.end() );
 
-        for ( set< AS >::iterator it = data[b].customerCone.begin(); it != data[b].customerCone.end(); ++it )
+        for ( pmr::set< AS >::iterator it = data[b].customerCone.begin(); it != data[b].customerCone.end(); ++it )
             data[*it].providerCone.insert( data[a].providerCone.begin(), data[a].providerCone.end() );
     }
 
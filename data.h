@@ -13,24 +13,79 @@
 #include <set>
 #include <vector>
 #include <string>
+#include <memory_resource>
+#include "arena.h"
+#include "prefixes.h"
+#include "evidence.h"
 
 using namespace std;
 
 typedef unsigned int AS;
 enum TypeOfRelationship { P2P = 0, P2C = -1, C2P = 1, S2S = 2, UNKNOWN = 3 }; // cf io.h
 
+struct Link
+{
+    AS a;
+    AS b;
+    TypeOfRelationship relationship; // From a's point of view
+};
+
+/*
+ * Options --> Parameters of loading and inference (defaults in data.cpp)
+ *
+ *      spillBuffer (bytes) [0 aggregates paths in memory, otherwise spilled in sorted runs of this size (cf external.h)]
+ *      threads (integer) [number of loading and inference threads (cf pipeline.h and parallel.h)]
+ *      useArena (boolean) [containers allocate from an arena (cf arena.h) rather than the heap]
+ *
+ *      cliqueCandidates (integer) [the clique is first searched amongst this many ASs of largest transit degree, at most 20]
+ *      peerTripletCount (integer) [x-y?z is oriented as y>z if seen more than this many times]
+ *      partialVPRatio (integer) [a VP is partial if it sees less than 1/partialVPRatio of the ASs]
+ *      smallerProviderCount (integer) [a provider with a smaller transit degree is accepted if seen more than this many times]
+ *      noProviderTransitDegree (integer) [minimal transit degree of ASs whose ties are broken when they have no provider]
+ *
+ *      approximateCones (integer) [0 keeps exact customer cones, otherwise the size of cone sketches (cf cones.h)]
+ *      samplePercent (integer) [percentage of partial VPs whose paths are loaded (cf sample.h)]
+ *      sampleFullPercent (integer) [percentage of full VPs whose paths are loaded, when sampling]
+ *      recordEvidence (boolean) [every relationship set is recorded in Data::evidence (cf evidence.h)]
+ */
+
+struct Options
+{
+    Options();
+
+    size_t spillBuffer;
+    unsigned int threads;
+    bool useArena;
+
+    unsigned int cliqueCandidates;
+    unsigned int peerTripletCount;
+    unsigned int partialVPRatio;
+    unsigned int smallerProviderCount;
+    unsigned int noProviderTransitDegree;
+
+    unsigned int approximateCones;
+    unsigned int samplePercent;
+    unsigned int sampleFullPercent;
+    bool recordEvidence;
+};
+
 /*
  * Data --> Overall data structure
  *
  *      asByRank (vector of AS)
+ *      vantagePoints (set of AS) [paths are only loaded from these VPs, or from all if empty (cf sample.h)]
+ *      prefixes (PrefixTable) [prefixes originated by each AS, from prefix|path lines (cf prefixes.h)]
+ *      evidence (EvidenceLog) [stage and triplet of each relationship set, if options.recordEvidence (cf evidence.h)]
  *
  * Data[x] --> AS data
  *
  *      inClique (boolean)
  *      rank (integer)
  *      transitDegree (integer) [transit degree as defined by CAIDA]
- *      customerCone (set of AS)
- *      providerCone (set of AS)
+ *      customerCone (set of AS) [empty with approximate cones]
+ *      providerCone (set of AS) [empty with approximate cones (cf providerConeFromLinks)]
+ *      providers (vector of AS) [ASs of the C2P links reflected in cones, only with approximate cones]
+ *      coneSketch (sorted vector of hashes) [bottom-k sketch of the customer cone, only with approximate cones (cf cones.h)]
  *      visibilityAsVP (set of AS) [all AS for which the VP announces a route]
  *      transitPairs (set of AS*AS ) [pairs y z such that y:x:z is in a path]
  *
@@ -38,6 +93,7 @@ enum TypeOfRelationship { P2P = 0, P2C = -1, C2P = 1, S2S = 2, UNKNOWN = 3 }; //
  *      
  *      transit (boolean) [their exists an AS z such that z:x:y is in a path]
  *      relationship (TypeOfRelationship)
+ *      inCones (boolean) [relationship set once cones were initialized, hence reflected in cones]
  *
  * Data[x][y][z] --> Triplet data
  *      
@@ -45,6 +101,12 @@ enum TypeOfRelationship { P2P = 0, P2C = -1, C2P = 1, S2S = 2, UNKNOWN = 3 }; //
  *      endOfPath (bool) [a path finished with z:y:x]
  *      twoEdgePath (bool) [the exact path x:y:z was seen]
  *      count (integer) [number of paths the triplet was in]
+ *
+ * All containers allocate from the memory resource of their Data (cf arena.h),
+ * by default a monotonic arena released at once with the Data, through one tagged
+ * resource per kind of structure (cf Structure in arena.h) that counts its nodes.
+ * The nodes of an arena are not destroyed one by one: the arena is released without
+ * walking the maps (cf ~Data).
  */
 
 struct TripletData
@@ -56,32 +118,76 @@ struct TripletData
     unsigned short int count;
 };
 
-struct LinkData : map< AS, TripletData >
+// LinkData and ASData take the allocator of the map they are inserted in (uses-allocator construction)
+struct LinkData : pmr::map< AS, TripletData >
 {
-    LinkData();
+    LinkData( const allocator_type& allocator = allocator_type() );
+    LinkData( const LinkData& l, const allocator_type& allocator );
     bool transit;
+    bool inCones;
     TypeOfRelationship relationship;
 };
 
-struct ASData : map< AS, LinkData >
+struct ASData : pmr::map< AS, LinkData >
 {
-    ASData();
-    set< AS > customerCone;
-    set< AS > providerCone;
-    set< AS > visibilityAsVP;
-    set< pair< AS, AS > > transitPairs;
+    ASData( const allocator_type& allocator = allocator_type() );
+    ASData( const ASData& d, const allocator_type& allocator );
+    pmr::set< AS > customerCone;
+    pmr::set< AS > providerCone;
+    pmr::set< AS > visibilityAsVP;
+    pmr::set< pair< AS, AS > > transitPairs;
+    pmr::vector< AS > providers;
+    pmr::vector< uint64_t > coneSketch;
     unsigned int transitDegree;
     unsigned int rank;
     bool inClique;
 };
 
-struct Data : map< AS, ASData >
+// Helper structure
+// Memory resource of a Data, constructed before and destroyed after its containers
+struct DataMemory
+{
+    DataMemory( bool useArena );
+    ~DataMemory();
+
+    CountingResource heap; // new/delete calls
+    Arena* arena; // 0 if containers directly use heap
+    pmr::memory_resource* resource;
+    TaggedResource structures[STRUCTURES]; // Upstream: resource
+
+private:
+    DataMemory( const DataMemory& );
+    DataMemory& operator=( const DataMemory& );
+};
+
+struct Data : DataMemory, pmr::map< AS, ASData >
 {
-    Data( const vector< string >& dataFiles, const vector< string >& relFile, const set< AS >& ixp, const set< AS >& clique );
-    bool setRelationship( AS a, AS b, TypeOfRelationship t );
+    Data( const Options& options = Options() );
+    Data( const vector< string >& dataFiles, const vector< string >& relFile, const set< AS >& ixp, const set< AS >& clique, const Options& options = Options() );
+    ~Data();
+    void initialize( const vector< string >& relFile, const set< AS >& clique );
+    bool setRelationship( AS a, AS b, TypeOfRelationship t, AS trigger = 0 ); // trigger: x in the triplet x a b, if any
+    void addToConeSketches( const vector< AS >& cone, AS b ); // Approximate cones: b joined the customer cones of cone (cf providerConeFromLinks)
 
+    const Options options;
+    set< AS > vantagePoints;
+    PrefixTable prefixes;
+    EvidenceLog evidence;
     vector< AS > asByRank;
+    bool conesInitialized;
+
+private:
+    Data( const Data& );
+    Data& operator=( const Data& );
+
+    alignas( pmr::map< AS, ASData > ) unsigned char released[sizeof( pmr::map< AS, ASData > )]; // Never destroyed (cf ~Data)
 };
 
+// Customer cone of b from the P2C links reflected in cones (cf LinkData::inCones), for approximate cones
+void customerConeFromLinks( const Data& data, AS b, vector< AS >& cone );
+
+// Provider cone of a from the C2P links reflected in cones, a first, for approximate cones
+void providerConeFromLinks( const Data& data, AS a, vector< AS >& cone );
+
 #endif
 
@@ -0,0 +1,238 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "evidence.h"
+#include "io.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <cstring>
+
+const char* const stageNames[STAGES] = { "relationship files", "clique", "addUpstreamProviderLinks", "findClientStubsSeenFromPartialVP",
+    "addLinksToSmallerProviders", "breakTiesWhenNoProvider", "setCliqueStubLinksAsP2C", "breakRemainingTies", "completeWithP2PLinks" };
+
+const char magic[8] = "asrkev1";
+
+// Helper functions
+// Order of records and path offsets in snapshots
+inline bool operator<( const EvidenceRecord& r, const EvidenceRecord& s ) { return r.a != s.a ? r.a < s.a : r.b < s.b; }
+
+inline bool operator<( const PathOffset& p, const PathOffset& q )
+{
+    if ( p.a != q.a )
+        return p.a < q.a;
+    if ( p.b != q.b )
+        return p.b < q.b;
+    if ( p.file != q.file )
+        return p.file < q.file;
+    return p.offset < q.offset;
+}
+
+// Helper function
+// Adds the links of an accepted path to paths, unless they already have evidencePaths paths
+inline void addPathOffsets( const vector< AS >& asPath, PathOffset p, unordered_map< uint64_t, unsigned int >& counts, vector< PathOffset >& paths )
+{
+    for ( size_t i = 1; i < asPath.size(); ++i )
+    {
+        p.a = min( asPath[i-1], asPath[i] );
+        p.b = max( asPath[i-1], asPath[i] );
+
+        unsigned int& count = counts[( static_cast< uint64_t >( p.a ) << 32 ) | p.b];
+        if ( count < evidencePaths )
+        {
+            ++count;
+            paths.push_back( p );
+        }
+    }
+}
+
+// Helper function
+// Writes n fixed size entries
+template< typename T >
+inline void writeEntries( ofstream& fs, const T* entries, uint64_t n )
+{
+    fs.write( reinterpret_cast< const char* >( &n ), sizeof( n ) );
+    fs.write( reinterpret_cast< const char* >( entries ), n * sizeof( T ) );
+}
+
+// Records are sorted by link, a < b, the relationship being from a's point of view
+// The paths of the links are found by reading pathFiles as loadPaths does (cf io.cpp), keeping the offset of each line
+void writeEvidence( const Data& data, const vector< string >& pathFiles, const set< AS >& ixp, const set< AS >& clique, const string& file )
+{
+    vector< EvidenceRecord > records( data.evidence.records() );
+
+    for ( vector< EvidenceRecord >::iterator it = records.begin(); it != records.end(); ++it )
+        if ( it->a > it->b )
+        {
+            swap( it->a, it->b );
+            it->reversed = 1;
+            if ( it->relationship == P2C || it->relationship == C2P )
+                it->relationship = -it->relationship;
+        }
+
+    sort( records.begin(), records.end() );
+
+    vector< PathOffset > paths;
+    unordered_map< uint64_t, unsigned int > counts;
+    vector< AS > asPath;
+
+    for ( unsigned int i = 0; i < pathFiles.size(); ++i )
+    {
+        ifstream fs( pathFiles[i].c_str() );
+        PathOffset p = { 0, 0, 0, i, 0 };
+        string line;
+
+        for ( ; getline( fs, line ); p.offset += line.size() + 1 )
+        {
+            if ( line.empty() || line.find( '#' ) != string::npos )
+                continue;
+
+            const char* path = line.data();
+            uint32_t network;
+            unsigned char length;
+            readPrefix( path, line.data() + line.size(), network, length );
+
+            istringstream is( line.substr( path - line.data() ) );
+            if ( !readPath( is, asPath, ixp, clique ) )
+                continue;
+
+            if ( !data.vantagePoints.empty() && data.vantagePoints.count( asPath[0] ) == 0 )
+                continue;
+
+            p.length = line.size();
+            addPathOffsets( asPath, p, counts, paths );
+        }
+    }
+
+    sort( paths.begin(), paths.end() );
+
+    ofstream fs( file.c_str(), ios::binary );
+    if ( !fs )
+        throw runtime_error( "cannot write " + file );
+
+    fs.write( magic, sizeof( magic ) );
+
+    const uint32_t files = pathFiles.size();
+    fs.write( reinterpret_cast< const char* >( &files ), sizeof( files ) );
+    for ( unsigned int i = 0; i < files; ++i )
+    {
+        const uint32_t length = pathFiles[i].size();
+        fs.write( reinterpret_cast< const char* >( &length ), sizeof( length ) );
+        fs.write( pathFiles[i].data(), length );
+    }
+
+    writeEntries( fs, records.data(), records.size() );
+    writeEntries( fs, paths.data(), paths.size() );
+}
+
+// Helper structure
+// Section of fixed size entries of a snapshot, sorted by link
+template< typename T >
+struct Section
+{
+    // Reads the size of the section at the current position of fs
+    Section( ifstream& f ) : fs( f ), size( 0 )
+    {
+        fs.read( reinterpret_cast< char* >( &size ), sizeof( size ) );
+        base = fs.tellg();
+    }
+
+    ifstream& fs;
+    uint64_t size;
+    streamoff base;
+
+    void read( uint64_t i, T& entry ) const
+    {
+        fs.seekg( base + static_cast< streamoff >( i * sizeof( T ) ) );
+        fs.read( reinterpret_cast< char* >( &entry ), sizeof( T ) );
+    }
+
+    streamoff end() const { return base + static_cast< streamoff >( size * sizeof( T ) ); }
+
+    // First entry whose link is not less than a b (binary search)
+    uint64_t lowerBound( AS a, AS b ) const
+    {
+        uint64_t first = 0, n = size;
+        T entry;
+
+        while ( n > 0 )
+        {
+            const uint64_t half = n / 2;
+            read( first + half, entry );
+
+            if ( entry.a < a || ( entry.a == a && entry.b < b ) )
+            {
+                first += half + 1;
+                n -= half + 1;
+            }
+            else
+                n = half;
+        }
+
+        return first;
+    }
+};
+
+bool explainRelationship( const string& snapshot, AS a, AS b, ostream& os )
+{
+    ifstream fs( snapshot.c_str(), ios::binary );
+    char header[sizeof( magic )];
+
+    if ( !fs.read( header, sizeof( header ) ) || memcmp( header, magic, sizeof( magic ) ) != 0 )
+        throw runtime_error( snapshot + " is not an evidence snapshot" );
+
+    uint32_t files = 0;
+    fs.read( reinterpret_cast< char* >( &files ), sizeof( files ) );
+
+    vector< string > pathFiles( files );
+    for ( unsigned int i = 0; i < files; ++i )
+    {
+        uint32_t length = 0;
+        fs.read( reinterpret_cast< char* >( &length ), sizeof( length ) );
+        pathFiles[i].resize( length );
+        fs.read( &pathFiles[i][0], length );
+    }
+
+    const AS x = min( a, b ), y = max( a, b );
+
+    const Section< EvidenceRecord > records( fs );
+    EvidenceRecord r;
+    const uint64_t i = records.lowerBound( x, y );
+    const bool found = i < records.size && ( records.read( i, r ), r.a == x && r.b == y );
+
+    if ( !found )
+    {
+        os << a << '|' << b << " : no relationship recorded" << endl;
+        return false;
+    }
+
+    const int relationship = a == x || r.relationship == P2P || r.relationship == S2S ? r.relationship : -r.relationship;
+    os << a << '|' << b << '|' << relationship << " : set by " << ( r.stage < STAGES ? stageNames[r.stage] : "unknown stage" )
+       << " (assignment " << r.sequence + 1 << " of " << records.size << ")";
+    if ( r.trigger != 0 )
+        os << ", triplet " << r.trigger << ' ' << ( r.reversed ? r.b : r.a ) << ' ' << ( r.reversed ? r.a : r.b );
+    os << endl;
+
+    fs.seekg( records.end() );
+    const Section< PathOffset > paths( fs );
+    PathOffset p;
+
+    for ( uint64_t j = paths.lowerBound( x, y ); j < paths.size && ( paths.read( j, p ), p.a == x && p.b == y ); ++j )
+    {
+        os << "  path " << ( p.file < files ? pathFiles[p.file] : "?" ) << ':' << p.offset;
+
+        ifstream ps( p.file < files ? pathFiles[p.file].c_str() : "", ios::binary );
+        string line( p.length, '\0' );
+        if ( ps.seekg( p.offset ) && ps.read( &line[0], p.length ) )
+            os << " : " << line;
+        os << endl;
+    }
+
+    return true;
+}
@@ -0,0 +1,110 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef EVIDENCE_H
+#define EVIDENCE_H
+
+#include <set>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+using namespace std;
+
+typedef unsigned int AS; // cf data.h
+
+// Stages in which relationships are set: initialization of Data, then the inference steps (cf ASRank::infer)
+enum Stage
+{
+    RELATIONSHIP_FILES,
+    CLIQUE,
+    ADD_UPSTREAM_PROVIDER_LINKS,
+    FIND_CLIENT_STUBS_SEEN_FROM_PARTIAL_VP,
+    ADD_LINKS_TO_SMALLER_PROVIDERS,
+    BREAK_TIES_WHEN_NO_PROVIDER,
+    SET_CLIQUE_STUB_LINKS_AS_P2C,
+    BREAK_REMAINING_TIES,
+    COMPLETE_WITH_P2P_LINKS,
+    STAGES
+};
+
+extern const char* const stageNames[STAGES];
+
+/*
+ * EvidenceLog --> Why each relationship of a Data was set (Options::recordEvidence, cf Data::setRelationship)
+ *
+ *      One record is appended per successful assignment, 20 bytes each: the link a b, the
+ *      relationship (from a's point of view), the stage, and the AS x of the triplet x a b
+ *      that triggered the assignment (0 if none, e.g. clique links or P2P completion).
+ *      Recording is a push_back on the assignment path, and a test of a flag when disabled.
+ *
+ * Evidence snapshot --> Binary file written from the log once inference is done (cf writeEvidence)
+ *
+ *      header      "asrkev1" magic, number of records, of path offsets and of path files
+ *      files       path file names (length then characters)
+ *      records     EvidenceRecord, sorted by link (a < b)
+ *      paths       PathOffset, sorted by link then offset
+ *
+ *      The paths of a link are the first evidencePaths accepted paths it is in, in file order,
+ *      found by one more pass over the path files when the snapshot is written. Both sections
+ *      have fixed size entries sorted by link: explainRelationship reads O(log n) entries.
+ */
+
+const unsigned int evidencePaths = 4; // Paths kept per link in snapshots
+
+struct EvidenceRecord
+{
+    AS a;
+    AS b;
+    AS trigger; // x in the triplet x a b, 0 if none
+    uint32_t sequence; // Position in the log
+    signed char relationship; // cf TypeOfRelationship
+    unsigned char stage; // cf Stage
+    unsigned char reversed; // In snapshots, 1 if set as b a (the triplet is then x b a)
+    unsigned char unused;
+};
+
+struct PathOffset
+{
+    uint64_t offset; // Of the line in the file
+    AS a;
+    AS b; // a < b
+    uint32_t file; // Index in the files of the snapshot
+    uint32_t length; // Of the line
+};
+
+class EvidenceLog
+{
+public:
+    EvidenceLog() : current( RELATIONSHIP_FILES ) {}
+
+    void begin( Stage stage ) { current = stage; }
+    void record( AS a, AS b, int relationship, AS trigger )
+    {
+        const EvidenceRecord r = { a, b, trigger, static_cast< uint32_t >( log.size() ), static_cast< signed char >( relationship ), current, 0, 0 };
+        log.push_back( r );
+    }
+
+    const vector< EvidenceRecord >& records() const { return log; }
+
+private:
+    vector< EvidenceRecord > log;
+    unsigned char current;
+};
+
+struct Data;
+
+// Writes the evidence snapshot of data, with the paths of pathFiles accepted by loadPaths (cf io.h)
+void writeEvidence( const Data& data, const vector< string >& pathFiles, const set< AS >& ixp, const set< AS >& clique, const string& file );
+
+// Explains the relationship of a and b from an evidence snapshot (stage, triggering triplet and paths)
+// Returns false if no relationship of a and b was recorded
+bool explainRelationship( const string& snapshot, AS a, AS b, ostream& os );
+
+#endif
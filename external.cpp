@@ -0,0 +1,355 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "external.h"
+#include <fstream>
+#include <sstream>
+#include <queue>
+#include <memory>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+///////////////////////////////////////////
+// Record format detailed in external.h //
+///////////////////////////////////////////
+
+// Helper function
+// Order used for sorting and merging records
+inline bool keyLess( const PathRecord& r, const PathRecord& s )
+{
+    if ( r.a != s.a )
+        return r.a < s.a;
+    if ( r.b != s.b )
+        return r.b < s.b;
+    if ( r.c != s.c )
+        return r.c < s.c;
+    return r.kind < s.kind;
+}
+
+inline bool keyEqual( const PathRecord& r, const PathRecord& s )
+{
+    return r.a == s.a && r.b == s.b && r.c == s.c && r.kind == s.kind;
+}
+
+// Helper function
+// Extracts the 16 bit digit number 'd' of the key, least significant first
+inline unsigned int digit( const PathRecord& r, unsigned int d )
+{
+    switch ( d )
+    {
+        case 0: return r.kind;
+        case 1: return r.c & 0xFFFF;
+        case 2: return r.c >> 16;
+        case 3: return r.b & 0xFFFF;
+        case 4: return r.b >> 16;
+        case 5: return r.a & 0xFFFF;
+        default: return r.a >> 16;
+    }
+}
+
+// Helper function
+// LSD radix sort of records on their key, using scratch as temporary storage
+// Passes where all records share the same digit are skipped (e.g. upper halves of 16 bit AS numbers)
+void radixSort( vector< PathRecord >& records, vector< PathRecord >& scratch )
+{
+    const size_t n = records.size();
+    vector< size_t > count( 1<<16 );
+
+    scratch.resize( n );
+
+    for ( unsigned int d = 0; d < 7; ++d )
+    {
+        fill( count.begin(), count.end(), 0 );
+        for ( size_t i = 0; i < n; ++i )
+            ++count[digit( records[i], d )];
+
+        if ( n == 0 || count[digit( records[0], d )] == n )
+            continue;
+
+        size_t offset = 0;
+        for ( unsigned int k = 0; k < count.size(); ++k )
+        {
+            const size_t c = count[k];
+            count[k] = offset;
+            offset += c;
+        }
+
+        for ( size_t i = 0; i < n; ++i )
+            scratch[count[digit( records[i], d )]++] = records[i];
+
+        records.swap( scratch );
+    }
+}
+
+// Helper function
+// Merges consecutive records with identical keys (records should be sorted)
+void reduce( vector< PathRecord >& records )
+{
+    size_t last = 0;
+    for ( size_t i = 1; i < records.size(); ++i )
+    {
+        if ( keyEqual( records[last], records[i] ) )
+        {
+            records[last].count += records[i].count;
+            records[last].flags |= records[i].flags;
+        }
+        else
+            records[++last] = records[i];
+    }
+
+    if ( !records.empty() )
+        records.resize( last + 1 );
+}
+
+// Helper class
+// Applies reduced records, in key order, to data
+// Same effect as addPath (cf io.cpp) once all records are applied
+class RecordApplier
+{
+public:
+    RecordApplier( Data& d ) : data( d ), dA( 0 ), dAB( 0 ) {}
+
+    void apply( const PathRecord& r )
+    {
+        if ( dA == 0 || r.a != a )
+        {
+            a = r.a;
+            dA = &data[a];
+            dAB = 0;
+        }
+
+        switch ( r.kind )
+        {
+            case PathRecord::VISIBILITY:
+                dA->visibilityAsVP.insert( r.b );
+                return;
+            case PathRecord::LINK:
+                (*dA)[r.b];
+                return;
+        }
+
+        if ( dAB == 0 || r.b != b )
+        {
+            b = r.b;
+            dAB = &(*dA)[b];
+        }
+
+        // r is a, b, c as z:y:x (upstream) or x:y:z
+        TripletData& triplet = (*dAB)[r.c];
+        triplet.count += r.count;
+        triplet.endOfPath |= ( r.flags & PathRecord::END_OF_PATH ) != 0;
+        triplet.twoEdgePath |= ( r.flags & PathRecord::TWO_EDGE_PATH ) != 0;
+
+        if ( ( r.flags & PathRecord::UPSTREAM ) && !triplet.upstream )
+        {
+            triplet.upstream = true;
+            ASData& dY = data[r.b];
+            dY[r.c].transit = true;
+            dY[r.a].transit = true;
+            dY.transitPairs.insert( make_pair( r.c, r.a ) );
+        }
+    }
+
+private:
+    Data& data;
+    AS a;
+    AS b;
+    ASData* dA;
+    LinkData* dAB;
+};
+
+// Helper class
+// Sequential reader of a spilled run, with a buffer of blockSize records
+class RunReader
+{
+public:
+    RunReader( const string& file, size_t blockSize ) : fs( file.c_str(), ios::binary ), block( blockSize ), position( 0 ), size( 0 )
+    {
+        if ( !fs )
+            throw runtime_error( "cannot open run " + file );
+    }
+
+    bool next( PathRecord& r )
+    {
+        if ( position == size )
+        {
+            fs.read( reinterpret_cast< char* >( &block[0] ), block.size() * sizeof( PathRecord ) );
+            size = fs.gcount() / sizeof( PathRecord );
+            position = 0;
+
+            if ( size == 0 )
+                return false;
+        }
+
+        r = block[position++];
+        return true;
+    }
+
+private:
+    ifstream fs;
+    vector< PathRecord > block;
+    size_t position;
+    size_t size;
+};
+
+// Helper functor
+// Required by the priority queue of the k-way merge (smallest key on top)
+struct MergeCompare
+{
+    bool operator()( const pair< PathRecord, size_t >& r, const pair< PathRecord, size_t >& s ) const
+    {
+        return keyLess( s.first, r.first );
+    }
+};
+
+// The buffer and its radix sort scratch space share bufferSize bytes
+RecordSorter::RecordSorter( size_t bufferSize ) : capacity( max< size_t >( bufferSize / ( 2 * sizeof( PathRecord ) ), 1<<10 ) ) {}
+
+RecordSorter::~RecordSorter()
+{
+    for ( unsigned int i = 0; i < runs.size(); ++i )
+        remove( runs[i].c_str() );
+
+    if ( !directory.empty() )
+        rmdir( directory.c_str() );
+}
+
+inline void RecordSorter::push( AS a, AS b, AS c, unsigned char kind, unsigned char flags )
+{
+    if ( buffer.size() == capacity )
+        spill();
+
+    const PathRecord r = { a, b, c, 1, kind, flags };
+    buffer.push_back( r );
+}
+
+// Emits the records corresponding to an accepted path (cf readPath in io.h)
+void RecordSorter::addPath( const vector< AS >& asPath )
+{
+    const unsigned int size = asPath.size();
+
+    if ( buffer.capacity() < capacity )
+        buffer.reserve( capacity );
+
+    push( asPath[0], asPath[size-1], 0, PathRecord::VISIBILITY, 0 );
+    push( asPath[0], asPath[1], 0, PathRecord::LINK, 0 );
+    push( asPath[1], asPath[0], 0, PathRecord::LINK, 0 );
+
+    for ( unsigned int i = 1; i + 1 < size; ++i )
+    {
+        const AS x = asPath[i-1], y = asPath[i], z = asPath[i+1];
+        const bool last = ( i == size - 2 );
+
+        push( z, y, x, PathRecord::TRIPLET, PathRecord::UPSTREAM | ( last ? PathRecord::END_OF_PATH : 0 ) );
+        push( x, y, z, PathRecord::TRIPLET, ( last && size == 3 ) ? PathRecord::TWO_EDGE_PATH : 0 );
+    }
+}
+
+// Sorts and reduces the buffer, then writes it as a new run
+void RecordSorter::spill()
+{
+    if ( directory.empty() )
+    {
+        const char* tmp = getenv( "TMPDIR" );
+        string pattern = string( tmp != 0 && *tmp != '\0' ? tmp : "/tmp" ) + "/asrank.XXXXXX";
+
+        if ( mkdtemp( &pattern[0] ) == 0 )
+            throw runtime_error( "cannot create temporary directory " + pattern );
+
+        directory = pattern;
+    }
+
+    radixSort( buffer, scratch );
+    reduce( buffer );
+
+    ostringstream name;
+    name << directory << "/run" << runs.size();
+    runs.push_back( name.str() );
+
+    ofstream fs( runs.back().c_str(), ios::binary );
+    fs.write( reinterpret_cast< const char* >( &buffer[0] ), buffer.size() * sizeof( PathRecord ) );
+
+    if ( !fs )
+        throw runtime_error( "cannot write run " + runs.back() );
+
+    buffer.clear();
+}
+
+// Merges all records into data
+// If nothing was spilled, the buffer is applied directly
+void RecordSorter::merge( Data& data )
+{
+    RecordApplier applier( data );
+
+    if ( runs.empty() )
+    {
+        radixSort( buffer, scratch );
+        reduce( buffer );
+
+        for ( size_t i = 0; i < buffer.size(); ++i )
+            applier.apply( buffer[i] );
+
+        vector< PathRecord >().swap( buffer );
+        vector< PathRecord >().swap( scratch );
+        return;
+    }
+
+    if ( !buffer.empty() )
+        spill();
+
+    vector< PathRecord >().swap( buffer );
+    vector< PathRecord >().swap( scratch );
+
+    // Run buffers use the memory freed by the record buffers
+    const size_t blockSize = max< size_t >( 2 * capacity / runs.size(), 1<<10 );
+    vector< unique_ptr< RunReader > > readers;
+    priority_queue< pair< PathRecord, size_t >, vector< pair< PathRecord, size_t > >, MergeCompare > heads;
+
+    for ( size_t i = 0; i < runs.size(); ++i )
+    {
+        readers.push_back( unique_ptr< RunReader >( new RunReader( runs[i], blockSize ) ) );
+
+        PathRecord r;
+        if ( readers[i]->next( r ) )
+            heads.push( make_pair( r, i ) );
+    }
+
+    bool pending = false;
+    PathRecord current;
+
+    while ( !heads.empty() )
+    {
+        const PathRecord r = heads.top().first;
+        const size_t i = heads.top().second;
+        heads.pop();
+
+        if ( pending && keyEqual( current, r ) )
+        {
+            current.count += r.count;
+            current.flags |= r.flags;
+        }
+        else
+        {
+            if ( pending )
+                applier.apply( current );
+
+            current = r;
+            pending = true;
+        }
+
+        PathRecord s;
+        if ( readers[i]->next( s ) )
+            heads.push( make_pair( s, i ) );
+    }
+
+    if ( pending )
+        applier.apply( current );
+}
+
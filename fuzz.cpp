@@ -0,0 +1,827 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include "asrank.h"
+#include "cones.h"
+#include "io.h"
+
+using namespace std;
+
+/*
+ * asrank-fuzz [--seed s] [--corpora n] [--ases n] [--paths n] [--out directory] [--golden asrank]
+ *
+ * Differential check of the loading and inference engines.
+ * Generates n random path corpora from seed s (hierarchical topology, full and partial VPs,
+ * with prepended ASs, IXPs, loops, clique violations, non numeric tokens and comments),
+ * then runs every engine configuration (cf engines) on each corpus in every scenario (cf scenarios),
+ * and compares it with the reference one (a single thread, in memory, exact cones) in the same scenario:
+ *
+ *      after loading       all the loaded data (links, triplets, transit pairs, VP visibility,
+ *                          transit degrees, ranks and origin prefixes)
+ *      after each step     all the relationships and provider cones, and the violations of
+ *                          invariants: links are symmetric (Data[x][y] exists iff Data[y][x]
+ *                          does, with the opposite relationship), exact cones are mutual
+ *                          (x is in the customer cone of y iff y is in the provider cone of x),
+ *                          sketches are those of the cones of the links with approximate cones,
+ *                          and the last evidence record of a link is its relationship with --evidence
+ *
+ * Scenarios give the same corpus as paths, as prefix|path lines (IPv4 and IPv6 prefixes), with a
+ * relationship file (part of the hierarchy, --rel), with a clique close to the one of the hierarchy (--clique) and
+ * with half of the VPs (--sample 50:50). Engines with several threads load paths and run the parallel
+ * inference passes (cf parallel.h); engines with --evidence load paths on their threads but infer serially.
+ *
+ * Engines are only compared with each other. With --golden, the final relationships of the reference
+ * (as printed by printGraph, with the clique) are also compared with the output of the asrank binary given
+ * (e.g. a build of a previous release), run with --ixp, --rel and --clique, in the scenarios it reads
+ * the same way (neither prefixes nor sampling). Intended changes of the inference show as differences.
+ *
+ * Not covered: the outputs other than relationships and cones (prefix cones, diffs, evidence snapshots
+ * and explain, server), the command line itself, and real world corpora.
+ *
+ * A failing corpus is minimized (paths are removed as long as the same engine still fails; not for the
+ * golden binary) and written with its IXP list, relationship file and clique in directory (default: current directory).
+ * The exit status is 1 if an engine or the golden binary failed.
+ *
+ * Defaults: seed 1, 20 corpora of about 400 ASs and 3000 paths.
+ */
+
+// Engine configurations compared with the reference (engines[0])
+struct Engine
+{
+    const char* name;
+    size_t spillBuffer;
+    unsigned int threads;
+    bool useArena;
+    unsigned int approximateCones;
+    bool recordEvidence;
+};
+
+const Engine engines[] =
+{
+    { "reference", 0, 1, true, 0, false },
+    { "--threads 2", 0, 2, true, 0, false },
+    { "--threads 3", 0, 3, true, 0, false },
+    { "--threads 8", 0, 8, true, 0, false },
+    { "--spill-buffer (1 kB runs)", 1, 1, true, 0, false },
+    { "--no-arena", 0, 1, false, 0, false },
+    { "--no-arena --threads 4", 0, 4, false, 0, false },
+    { "--approx-cones 16", 0, 1, true, 16, false },
+    { "--approx-cones 16 --threads 4", 0, 4, true, 16, false },
+    { "--spill-buffer (1 kB runs) --threads 3", 1, 3, true, 0, false },
+    { "--evidence", 0, 1, true, 0, true },
+    { "--evidence --threads 4 --approx-cones 16", 0, 4, true, 16, true }
+};
+
+const unsigned int engineCount = sizeof( engines ) / sizeof( engines[0] );
+
+// Inputs given to every engine for a corpus (cf Corpus)
+struct Scenario
+{
+    const char* name;
+    bool prefixes; // prefix|path lines
+    bool relationships; // Relationship file
+    bool clique; // Given clique (cf Corpus), instead of the computed one
+    unsigned int samplePercent; // Of full and partial VPs
+    bool golden; // Compared with the golden binary (cf compareGolden)
+};
+
+const Scenario scenarios[] =
+{
+    { "paths", false, false, false, 100, true },
+    { "prefix|path", true, false, false, 100, false },
+    { "--rel", false, true, false, 100, true },
+    { "--clique", false, false, true, 100, true },
+    { "--rel --clique", false, true, true, 100, true },
+    { "--sample 50:50", false, false, false, 50, false }
+};
+
+const unsigned int scenarioCount = sizeof( scenarios ) / sizeof( scenarios[0] );
+
+// Input files and sets of a run
+struct Inputs
+{
+    string paths;
+    string relationships; // Empty if none
+    set< AS > ixp;
+    set< AS > clique; // Computed by the engine if empty
+    unsigned int samplePercent;
+};
+
+// State of an engine after loading and after each inference step
+typedef vector< pair< string, string > > States;
+
+// Helper function
+// Canonical text of loaded data
+string loadedState( const Data& data )
+{
+    ostringstream os;
+
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+    {
+        const ASData& d = it->second;
+
+        os << "as " << it->first << " degree " << d.transitDegree << " rank " << d.rank << " clique " << d.inClique << '\n';
+
+        for ( pmr::set< AS >::const_iterator jt = d.visibilityAsVP.begin(); jt != d.visibilityAsVP.end(); ++jt )
+            os << "  visible " << *jt << '\n';
+
+        for ( pmr::set< pair< AS, AS > >::const_iterator jt = d.transitPairs.begin(); jt != d.transitPairs.end(); ++jt )
+            os << "  transit " << jt->first << ' ' << jt->second << '\n';
+
+        const PrefixTable::Entry* end;
+        for ( const PrefixTable::Entry* jt = data.prefixes.prefixes( it->first, end ); jt != end; ++jt )
+            os << "  prefix " << jt->network << '/' << static_cast< int >( jt->length ) << '\n';
+
+        for ( ASData::const_iterator jt = d.begin(); jt != d.end(); ++jt )
+        {
+            os << "  link " << jt->first << " transit " << jt->second.transit << " relationship " << jt->second.relationship << '\n';
+
+            for ( LinkData::const_iterator kt = jt->second.begin(); kt != jt->second.end(); ++kt )
+                os << "    triplet " << kt->first << ' ' << kt->second.count << ' ' << kt->second.upstream
+                   << kt->second.endOfPath << kt->second.twoEdgePath << '\n';
+        }
+    }
+
+    return os.str();
+}
+
+// Helper function
+// Relationship of b with a, given the relationship of a with b
+inline TypeOfRelationship opposite( TypeOfRelationship t )
+{
+    return t == P2C ? C2P : t == C2P ? P2C : t;
+}
+
+// Helper function
+// Violations of the evidence log: the last record of a link must be its relationship, and a link without record must be unknown
+void checkEvidence( const Data& data, ostream& os )
+{
+    map< pair< AS, AS >, TypeOfRelationship > last;
+    const vector< EvidenceRecord >& records = data.evidence.records();
+
+    for ( vector< EvidenceRecord >::const_iterator it = records.begin(); it != records.end(); ++it )
+    {
+        const TypeOfRelationship t = static_cast< TypeOfRelationship >( it->relationship );
+        if ( it->a < it->b )
+            last[make_pair( it->a, it->b )] = t;
+        else
+            last[make_pair( it->b, it->a )] = opposite( t );
+    }
+
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        for ( ASData::const_iterator jt = it->second.begin(); jt != it->second.end(); ++jt )
+            if ( it->first < jt->first )
+            {
+                map< pair< AS, AS >, TypeOfRelationship >::const_iterator l = last.find( make_pair( it->first, jt->first ) );
+                if ( l == last.end() ? jt->second.relationship != UNKNOWN : l->second != jt->second.relationship )
+                    os << "  evidence of " << it->first << '|' << jt->first << " is not its relationship\n";
+            }
+}
+
+// Helper function
+// Canonical text of the inference state (customer cones are not kept by every engine, only their invariant is)
+// With approximate cones, provider cones are those of the links, and sketches must be those of the cones of the links
+string inferenceState( const Data& data )
+{
+    ostringstream os;
+
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+    {
+        const ASData& d = it->second;
+
+        vector< AS > providers( d.providerCone.begin(), d.providerCone.end() );
+        if ( data.options.approximateCones != 0 && data.conesInitialized )
+        {
+            providerConeFromLinks( data, it->first, providers );
+            sort( providers.begin(), providers.end() );
+        }
+
+        os << "as " << it->first << " providers";
+        for ( vector< AS >::const_iterator jt = providers.begin(); jt != providers.end(); ++jt )
+            os << ' ' << *jt;
+        os << '\n';
+
+        if ( data.options.approximateCones != 0 && data.conesInitialized )
+        {
+            vector< AS > cone;
+            vector< uint64_t > sketch;
+            customerConeFromLinks( data, it->first, cone );
+            for ( vector< AS >::const_iterator jt = cone.begin(); jt != cone.end(); ++jt )
+                sketch.push_back( hash64( *jt ) );
+            sort( sketch.begin(), sketch.end() );
+            sketch.resize( min< size_t >( sketch.size(), max( data.options.approximateCones, 3u ) ) );
+
+            if ( !equal( sketch.begin(), sketch.end(), d.coneSketch.begin(), d.coneSketch.end() ) )
+                os << "  sketch of " << it->first << " is not the one of its cone\n";
+        }
+
+        for ( ASData::const_iterator jt = d.begin(); jt != d.end(); ++jt )
+        {
+            if ( it->first < jt->first )
+                os << "  " << it->first << '|' << jt->first << '|' << jt->second.relationship << '\n';
+
+            Data::const_iterator y = data.find( jt->first );
+            ASData::const_iterator kt = y != data.end() ? y->second.find( it->first ) : ASData::const_iterator();
+            if ( y == data.end() || kt == y->second.end() || kt->second.relationship != opposite( jt->second.relationship ) )
+                os << "  asymmetric link " << it->first << '|' << jt->first << '\n';
+        }
+
+        for ( pmr::set< AS >::const_iterator jt = d.customerCone.begin(); jt != d.customerCone.end(); ++jt )
+            if ( data.at( *jt ).providerCone.count( it->first ) == 0 )
+                os << "  customer " << *jt << " without provider " << it->first << '\n';
+
+        if ( data.options.approximateCones == 0 )
+            for ( pmr::set< AS >::const_iterator jt = d.providerCone.begin(); jt != d.providerCone.end(); ++jt )
+                if ( data.at( *jt ).customerCone.count( it->first ) == 0 )
+                    os << "  provider " << *jt << " without customer " << it->first << '\n';
+    }
+
+    if ( data.options.recordEvidence )
+        checkEvidence( data, os );
+
+    return os.str();
+}
+
+// Helper functor
+// Records the state after each inference step
+struct Recorder
+{
+    Recorder( States& s ) : states( s ) {}
+    States& states;
+
+    void operator()( const string& stage, const Data& data ) const { states.push_back( make_pair( stage, inferenceState( data ) ) ); }
+};
+
+// Helper function
+// Final relationships as printed by printGraph (cf io.cpp)
+string graphText( const ASRank& asrank )
+{
+    ostringstream os;
+
+    os << "# " << asrank.data().size() << " visible AS\n# Clique :";
+    for ( set< AS >::const_iterator it = asrank.clique().begin(); it != asrank.clique().end(); ++it )
+        os << ' ' << *it;
+    os << '\n';
+
+    LinkView links = asrank.links();
+    for ( LinkView::iterator it = links.begin(); it != links.end(); ++it )
+        os << it->a << '|' << it->b << '|' << static_cast< int >( it->relationship ) << '\n';
+
+    return os.str();
+}
+
+// Helper function
+// Writes the links of graph to file, every other one as b|a|r' (r' = -r for P2C and C2P, CAIDA files writing providers first)
+// Returns the number of links
+size_t writeReversed( const string& file, const string& graph )
+{
+    istringstream is( graph );
+    ofstream fs( file.c_str() );
+    string line;
+    size_t links = 0;
+
+    while ( getline( is, line ) )
+    {
+        if ( line.empty() || line[0] == '#' )
+            continue;
+
+        AS a, b;
+        int t;
+        char separator;
+        istringstream( line ) >> a >> separator >> b >> separator >> t;
+
+        if ( links++ % 2 == 0 )
+            fs << b << '|' << a << '|' << ( t == P2C || t == C2P ? -t : t ) << '\n';
+        else
+            fs << line << '\n';
+    }
+
+    return links;
+}
+
+// Helper function
+// Checks printDiff on data against its own graph written by writeReversed to file
+// Returns an empty string if every link is unchanged, otherwise the summary line or the error of printDiff
+string diffText( const Data& data, const string& graph, const string& file )
+{
+    const size_t links = writeReversed( file, graph );
+    ostringstream os, expected;
+
+    try
+    {
+        printDiff( data, file, os );
+    }
+    catch ( const exception& e )
+    {
+        return e.what();
+    }
+
+    expected << "# diff against " << file << "\n# 0 added, 0 removed, 0 changed, " << links << " unchanged\n";
+
+    if ( os.str() == expected.str() )
+        return string();
+
+    const string text = os.str();
+    const size_t end = text.find_last_not_of( '\n' ), begin = text.rfind( '\n', end ) + 1;
+    return text.substr( begin, end + 1 - begin ); // Summary line
+}
+
+// Helper function
+// Runs an engine on inputs, returns its states
+// If graph is not null, it gets the final relationships, and diff the patch of printDiff against them in reversed orientation (cf diffText)
+States run( const Engine& engine, const Inputs& inputs, string* graph = 0, string* diff = 0 )
+{
+    Options options;
+    options.spillBuffer = engine.spillBuffer;
+    options.threads = engine.threads;
+    options.useArena = engine.useArena;
+    options.approximateCones = engine.approximateCones;
+    options.recordEvidence = engine.recordEvidence;
+    options.samplePercent = inputs.samplePercent;
+    options.sampleFullPercent = inputs.samplePercent;
+
+    ASRank asrank( options );
+    asrank.addPathFile( inputs.paths );
+    asrank.addIXPs( inputs.ixp );
+    if ( !inputs.relationships.empty() )
+        asrank.addRelationshipFile( inputs.relationships );
+    if ( !inputs.clique.empty() )
+        asrank.setClique( inputs.clique );
+
+    States states;
+
+    try
+    {
+        asrank.load();
+        states.push_back( make_pair( string( "loading" ), loadedState( asrank.data() ) ) );
+        asrank.infer( Recorder( states ) );
+
+        if ( graph != 0 )
+        {
+            *graph = graphText( asrank );
+            *diff = diffText( asrank.data(), *graph, inputs.paths + ".previous" );
+        }
+    }
+    catch ( const exception& e )
+    {
+        states.push_back( make_pair( string( "exception" ), string( e.what() ) ) );
+    }
+
+    return states;
+}
+
+// Helper function
+// First line of text that differs from the one of reference
+string firstDifference( const string& reference, const string& text )
+{
+    istringstream r( reference ), s( text );
+    string rLine, sLine;
+
+    while ( getline( r, rLine ) && getline( s, sLine ) && rLine == sLine );
+
+    return "\"" + rLine + "\" instead of \"" + sLine + "\"";
+}
+
+// Helper function
+// Compares states with the reference ones, describes the first difference
+// Returns false if they differ
+bool compare( const States& reference, const States& states, string& difference )
+{
+    for ( size_t i = 0; i < reference.size(); ++i )
+    {
+        if ( i == states.size() || states[i].first != reference[i].first )
+        {
+            difference = "missing step " + reference[i].first + ( i < states.size() ? " (" + states[i].first + ": " + states[i].second + ")" : "" );
+            return false;
+        }
+
+        if ( states[i].second == reference[i].second )
+            continue;
+
+        difference = "after " + reference[i].first + ": " + firstDifference( reference[i].second, states[i].second );
+        return false;
+    }
+
+    return true;
+}
+
+// Random corpus: a hierarchy of ASs and paths from its VPs, with noise
+// prefixedLines are the lines with prefixes, relationships part of the hierarchy (CAIDA format), with noise too
+class Corpus
+{
+public:
+    Corpus( mt19937& random, unsigned int ases, unsigned int paths );
+
+    vector< string > lines;
+    vector< string > prefixedLines;
+    vector< string > relationships;
+    set< AS > ixp;
+    set< AS > clique;
+
+private:
+    void climb( AS x, vector< AS >& chain );
+    string write( const vector< AS >& path );
+    string prefix();
+
+    mt19937& random;
+    vector< AS > numbers; // AS numbers, clique first
+    vector< vector< unsigned int > > providers;
+    unsigned int cliqueSize;
+};
+
+Corpus::Corpus( mt19937& r, unsigned int ases, unsigned int paths ) : random( r )
+{
+    set< AS > used;
+
+    while ( used.size() < ases + 4 )
+        used.insert( random() % 4 == 0 ? 4200000000u + random() % 1000000 : 1 + random() % 65000 ); // Some 32 bit AS numbers
+
+    numbers.assign( used.begin(), used.end() );
+    shuffle( numbers.begin(), numbers.end(), random );
+
+    for ( unsigned int i = 0; i < 4; ++i )
+        ixp.insert( numbers[ases+i] );
+    numbers.resize( ases );
+
+    // AS i gets providers amongst ASs 0..i-1, mostly the first ones
+    cliqueSize = 3 + random() % 5;
+    providers.resize( ases );
+    for ( unsigned int i = cliqueSize; i < ases; ++i )
+    {
+        const unsigned int count = 1 + random() % 3;
+        for ( unsigned int k = 0; k < count; ++k )
+        {
+            const double u = uniform_real_distribution< double >( 0, 1 )( random );
+            providers[i].push_back( static_cast< unsigned int >( i * u * u ) );
+        }
+    }
+
+    // Full VPs see every AS, partial VPs a few of them
+    const unsigned int fullVPs = 2 + random() % 4, partialVPs = 5 + random() % 20;
+    vector< unsigned int > vps;
+    for ( unsigned int k = 0; k < fullVPs + partialVPs; ++k )
+        vps.push_back( random() % ases );
+
+    for ( unsigned int p = 0; p < paths; ++p )
+    {
+        const unsigned int v = random() % 4 != 0 ? random() % fullVPs : fullVPs + random() % partialVPs;
+        const unsigned int destination = v < fullVPs ? random() % ases : random() % ( ases / 8 + 1 );
+
+        vector< AS > up, down;
+        climb( vps[v], up );
+        climb( destination, down );
+
+        if ( up.back() != down.back() )
+            up.push_back( down.back() );
+        up.insert( up.end(), down.rbegin() + 1, down.rend() );
+
+        lines.push_back( write( up ) );
+        prefixedLines.push_back( lines.back().empty() || lines.back()[0] == '#' || random() % 10 == 0 ? lines.back() : prefix() + '|' + lines.back() );
+    }
+
+    // Given clique: the one of the hierarchy, with its last AS replaced by one of its customers
+    clique.insert( numbers.begin(), numbers.begin() + cliqueSize - 1 );
+    clique.insert( numbers[cliqueSize] );
+
+    // Some clique links, provider links and siblings, a few of them twice
+    relationships.push_back( "# relationships" );
+    for ( unsigned int i = 0; i < cliqueSize; ++i )
+        for ( unsigned int j = i + 1; j < cliqueSize; ++j )
+            if ( random() % 3 == 0 )
+                relationships.push_back( to_string( numbers[i] ) + '|' + to_string( numbers[j] ) + "|0" );
+
+    for ( unsigned int i = cliqueSize; i < ases; ++i )
+        for ( size_t k = 0; k < providers[i].size(); ++k )
+        {
+            const unsigned int noise = random() % 100;
+            const string p = to_string( numbers[providers[i][k]] ), c = to_string( numbers[i] );
+
+            if ( noise < 8 )
+                relationships.push_back( p + '|' + c + "|-1" );
+            else if ( noise == 8 )
+                relationships.push_back( c + '|' + p + "|1" );
+            else if ( noise == 9 )
+                relationships.push_back( p + '|' + c + "|2" );
+            else if ( noise == 10 ) // Given twice, the first one is kept
+            {
+                relationships.push_back( p + '|' + c + "|-1" );
+                relationships.push_back( c + '|' + p + "|0" );
+            }
+        }
+}
+
+// Chain of providers from x to a clique AS (identifiers)
+void Corpus::climb( AS x, vector< AS >& chain )
+{
+    chain.assign( 1, x );
+
+    while ( chain.back() >= cliqueSize )
+    {
+        const vector< unsigned int >& p = providers[chain.back()];
+        chain.push_back( p[random() % p.size()] );
+    }
+}
+
+// Writes a path of identifiers as a line, with noise
+string Corpus::write( const vector< AS >& path )
+{
+    ostringstream os;
+    const unsigned int noise = random() % 40;
+
+    if ( noise == 0 )
+        return "# comment " + to_string( random() );
+    if ( noise == 1 )
+        return "";
+
+    vector< AS > ases;
+    for ( size_t i = 0; i < path.size(); ++i )
+    {
+        ases.push_back( numbers[path[i]] );
+
+        if ( random() % 10 == 0 ) // Prepending
+            ases.push_back( ases.back() );
+        if ( random() % 15 == 0 ) // IXP
+            ases.push_back( *next( ixp.begin(), random() % ixp.size() ) );
+    }
+
+    if ( noise == 2 && ases.size() > 2 ) // Loop
+        ases.push_back( ases[random() % ( ases.size() - 1 )] );
+    if ( noise == 3 ) // Clique AS not consecutive with the others
+        ases.insert( ases.begin() + random() % ases.size(), numbers[random() % cliqueSize] );
+    if ( noise == 4 ) // IXP at the end
+        ases.push_back( *ixp.begin() );
+
+    for ( size_t i = 0; i < ases.size(); ++i )
+        os << ( i != 0 ? ( random() % 20 == 0 ? "  " : " " ) : "" ) << ases[i];
+
+    if ( noise == 5 ) // Token that is not an AS number
+        os << " {" << ases[0] << ',' << ases.back() << '}';
+    if ( noise == 6 )
+        os << ' ';
+
+    return os.str();
+}
+
+// IPv4 prefix, sometimes with host bits or an IPv6 one (ignored)
+string Corpus::prefix()
+{
+    ostringstream os;
+
+    if ( random() % 20 == 0 )
+        os << "2001:db8:" << hex << random() % 65536 << "::/48";
+    else
+        os << random() % 224 << '.' << random() % 256 << '.' << ( random() % 4 == 0 ? random() % 256 : 0 ) << ".0/" << 8 + random() % 17;
+
+    return os.str();
+}
+
+// Helper function
+// Writes lines to a file
+void writeLines( const string& file, const vector< string >& lines )
+{
+    ofstream fs( file.c_str() );
+    for ( size_t i = 0; i < lines.size(); ++i )
+        fs << lines[i] << '\n';
+}
+
+// Helper function
+// Writes a set of ASs to a file, one per line
+void writeASes( const string& file, const set< AS >& ases )
+{
+    ofstream fs( file.c_str() );
+    for ( set< AS >::const_iterator it = ases.begin(); it != ases.end(); ++it )
+        fs << *it << '\n';
+}
+
+// Helper function
+// True if engine differs from the reference on lines, with the other inputs of inputs
+bool fails( const Engine& engine, const vector< string >& lines, Inputs inputs, const string& file )
+{
+    writeLines( file, lines );
+    inputs.paths = file;
+
+    string difference;
+    return !compare( run( engines[0], inputs ), run( engine, inputs ), difference );
+}
+
+// Helper function
+// Removes chunks of lines, halving their size, as long as engine still fails
+void minimize( const Engine& engine, vector< string >& lines, const Inputs& inputs, const string& file )
+{
+    for ( size_t chunk = lines.size() / 2; chunk >= 1; chunk /= 2 )
+        for ( size_t begin = 0; begin < lines.size(); )
+        {
+            vector< string > candidate( lines.begin(), lines.begin() + begin );
+            candidate.insert( candidate.end(), lines.begin() + min( begin + chunk, lines.size() ), lines.end() );
+
+            if ( !candidate.empty() && fails( engine, candidate, inputs, file ) )
+                lines.swap( candidate );
+            else
+                begin += chunk;
+        }
+}
+
+// Helper function
+// Writes lines and the other inputs as name.paths, name.ixp, name.rel and name.clique, returns their description
+string save( const string& name, const vector< string >& lines, const Inputs& inputs, const Corpus& corpus )
+{
+    ostringstream os;
+
+    writeLines( name + ".paths", lines );
+    writeASes( name + ".ixp", inputs.ixp );
+    os << lines.size() << " paths in " << name << ".paths (IXPs in " << name << ".ixp";
+
+    if ( !inputs.relationships.empty() )
+    {
+        writeLines( name + ".rel", corpus.relationships );
+        os << ", relationships in " << name << ".rel";
+    }
+
+    if ( !inputs.clique.empty() )
+    {
+        writeASes( name + ".clique", inputs.clique );
+        os << ", clique in " << name << ".clique";
+    }
+
+    if ( inputs.samplePercent < 100 )
+        os << ", --sample " << inputs.samplePercent << ':' << inputs.samplePercent;
+
+    os << ')';
+    return os.str();
+}
+
+// Helper function
+// Runs the golden binary on inputs (with --ixp, --rel and --clique only) in directory, compares its output with graph
+// Returns false if they differ
+bool compareGolden( const string& golden, const Inputs& inputs, const string& directory, const string& graph, string& difference )
+{
+    const string output = directory + "/golden";
+    string command = golden + " --ixp " + directory + "/ixp";
+
+    writeASes( directory + "/ixp", inputs.ixp );
+    if ( !inputs.relationships.empty() )
+        command += " --rel " + inputs.relationships;
+    if ( !inputs.clique.empty() )
+    {
+        writeASes( directory + "/clique", inputs.clique );
+        command += " --clique " + directory + "/clique";
+    }
+    command += " " + inputs.paths + " > " + output + " 2> /dev/null";
+
+    if ( system( command.c_str() ) != 0 )
+    {
+        difference = "failed: " + command;
+        return false;
+    }
+
+    ifstream fs( output.c_str() );
+    ostringstream text;
+    text << fs.rdbuf();
+
+    if ( text.str() == graph )
+        return true;
+
+    difference = firstDifference( graph, text.str() );
+    return false;
+}
+
+int main( int argc, char** argv )
+{
+    unsigned int seed = 1, corpora = 20, ases = 400, paths = 3000;
+    string out = ".", golden;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        const string arg( argv[i] );
+
+        if ( arg == "--seed" )
+            seed = strtoul( argv[i+1], 0, 10 );
+        else if ( arg == "--corpora" )
+            corpora = strtoul( argv[i+1], 0, 10 );
+        else if ( arg == "--ases" )
+            ases = max( 20ul, strtoul( argv[i+1], 0, 10 ) );
+        else if ( arg == "--paths" )
+            paths = strtoul( argv[i+1], 0, 10 );
+        else if ( arg == "--out" )
+            out = argv[i+1];
+        else if ( arg == "--golden" )
+            golden = argv[i+1];
+        else
+        {
+            cerr << "Usage : asrank-fuzz [--seed s] [--corpora n] [--ases n] [--paths n] [--out directory] [--golden asrank]" << endl;
+            return 1;
+        }
+    }
+
+    const char* tmp = getenv( "TMPDIR" );
+    string directory = string( tmp != 0 && *tmp != '\0' ? tmp : "/tmp" ) + "/asrank-fuzz.XXXXXX";
+    if ( mkdtemp( &directory[0] ) == 0 )
+    {
+        cerr << "asrank-fuzz : cannot create a temporary directory" << endl;
+        return 1;
+    }
+
+    const string file = directory + "/corpus", relFile = directory + "/rel";
+    mt19937 random( seed );
+    bool failed = false;
+
+    for ( unsigned int c = 0; c < corpora; ++c )
+    {
+        Corpus corpus( random, ases, paths );
+        writeLines( relFile, corpus.relationships );
+
+        for ( unsigned int s = 0; s < scenarioCount; ++s )
+        {
+            const Scenario& scenario = scenarios[s];
+            const vector< string >& corpusLines = scenario.prefixes ? corpus.prefixedLines : corpus.lines;
+            writeLines( file, corpusLines );
+
+            Inputs inputs;
+            inputs.paths = file;
+            inputs.relationships = scenario.relationships ? relFile : string();
+            inputs.ixp = corpus.ixp;
+            inputs.clique = scenario.clique ? corpus.clique : set< AS >();
+            inputs.samplePercent = scenario.samplePercent;
+
+            string graph, diff;
+            const States reference = run( engines[0], inputs, &graph, &diff );
+            unsigned int passed = 1;
+
+            if ( !diff.empty() )
+            {
+                failed = true;
+
+                ostringstream name;
+                name << out << "/fuzz-" << seed << '-' << c << '-' << s << "-diff";
+                cout << "corpus " << c << " (" << scenario.name << ") : printDiff against the reversed links differs: "
+                     << diff << endl
+                     << "corpus " << c << " (" << scenario.name << ") : " << save( name.str(), corpusLines, inputs, corpus ) << endl;
+            }
+
+            for ( unsigned int e = 1; e < engineCount; ++e )
+            {
+                string difference;
+                if ( compare( reference, run( engines[e], inputs ), difference ) )
+                {
+                    ++passed;
+                    continue;
+                }
+
+                failed = true;
+                cout << "corpus " << c << " (" << scenario.name << ") : " << engines[e].name << " differs " << difference << endl;
+
+                vector< string > lines( corpusLines );
+                minimize( engines[e], lines, inputs, directory + "/minimize" );
+
+                ostringstream name;
+                name << out << "/fuzz-" << seed << '-' << c << '-' << s << '-' << e;
+                cout << "corpus " << c << " (" << scenario.name << ") : minimized to " << save( name.str(), lines, inputs, corpus ) << endl;
+            }
+
+            cout << "corpus " << c << " (" << scenario.name << ") : " << corpusLines.size() << " paths, " << reference.size() - 1 << " steps, "
+                 << passed << '/' << engineCount << " engines identical";
+
+            if ( !golden.empty() && scenario.golden )
+            {
+                string difference;
+                if ( compareGolden( golden, inputs, directory, graph, difference ) )
+                    cout << ", golden identical" << endl;
+                else
+                {
+                    failed = true;
+
+                    ostringstream name;
+                    name << out << "/fuzz-" << seed << '-' << c << '-' << s << "-golden";
+                    cout << ", golden differs " << difference << endl
+                         << "corpus " << c << " (" << scenario.name << ") : " << save( name.str(), corpusLines, inputs, corpus ) << endl;
+                }
+            }
+            else
+                cout << endl;
+        }
+    }
+
+    const char* const files[] = { "/corpus", "/corpus.previous", "/minimize", "/rel", "/ixp", "/clique", "/golden" };
+    for ( unsigned int i = 0; i < sizeof( files ) / sizeof( files[0] ); ++i )
+        remove( ( directory + files[i] ).c_str() );
+    rmdir( directory.c_str() );
+
+    return failed ? 1 : 0;
+}
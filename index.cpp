@@ -0,0 +1,249 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "index.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+const uint64_t bitmapFlag = uint64_t( 1 ) << 63;
+
+// Helper function
+// Required to sort links by (a, b)
+inline bool linkLess( const Link& l, const Link& m )
+{
+    return l.a != m.a ? l.a < m.a : l.b < m.b;
+}
+
+// Snapshot of the relationships of data
+GraphIndex::GraphIndex( const Data& data )
+{
+    vector< Link > l;
+
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        for ( ASData::const_iterator jt = it->second.begin(); jt != it->second.end(); ++jt )
+            if ( it->first < jt->first )
+            {
+                const Link link = { it->first, jt->first, jt->second.relationship };
+                l.push_back( link );
+            }
+
+    build( l );
+
+    // Same cones as Data (cf printConeSizes): its customer cones, or with approximate cones
+    // the exact cones of the links they are estimated from (cf customerConeFromLinks)
+    vector< AS > members;
+    vector< uint32_t > cone;
+
+    coneOffsets.resize( ases.size() );
+    coneSizes.resize( ases.size() );
+
+    for ( uint32_t i = 0; i < ases.size(); ++i )
+    {
+        const ASData& dA = data.at( ases[i] );
+        if ( data.options.approximateCones == 0 )
+            members.assign( dA.customerCone.begin(), dA.customerCone.end() );
+        else
+            customerConeFromLinks( data, ases[i], members );
+
+        cone.clear();
+        for ( size_t k = 0; k < members.size(); ++k )
+            if ( id( members[k] ) != ases.size() )
+                cone.push_back( id( members[k] ) );
+
+        storeCone( i, cone );
+    }
+}
+
+// Snapshot of the relationships listed in a CAIDA file (cf printGraph)
+// Only the first occurrence of a link is kept
+GraphIndex::GraphIndex( const string& relFile )
+{
+    ifstream fs( relFile.c_str() );
+    const char eof = char_traits< char >::eof();
+    vector< Link > l;
+    char peek;
+    int t;
+
+    if ( !fs )
+        throw runtime_error( "cannot open " + relFile );
+
+    while ( ( peek = fs.peek() ) != eof )
+    {
+        switch ( peek )
+        {
+            case ' ':
+            case '\n':
+                fs.ignore();
+                break;
+            case '#':
+                fs.ignore( 1024, '\n' );
+                break;
+            default:
+                Link link;
+                fs >> link.a;
+                fs.ignore();
+                fs >> link.b;
+                fs.ignore();
+                fs >> t;
+                if ( !fs )
+                    throw runtime_error( "invalid relationship in " + relFile );
+                link.relationship = static_cast< TypeOfRelationship >( t );
+                l.push_back( link );
+                break;
+        }
+    }
+
+    build( l );
+    computeCones();
+}
+
+// Builds the adjacency from links given once (in any direction)
+void GraphIndex::build( vector< Link >& l )
+{
+    const size_t given = l.size();
+
+    for ( size_t i = 0; i < given; ++i )
+    {
+        TypeOfRelationship t = l[i].relationship;
+        if ( t == P2C || t == C2P )
+            t = static_cast< TypeOfRelationship >( -t );
+
+        const Link reverse = { l[i].b, l[i].a, t };
+        l.push_back( reverse );
+    }
+
+    stable_sort( l.begin(), l.end(), linkLess );
+
+    for ( size_t i = 0; i < l.size(); ++i )
+    {
+        if ( i != 0 && l[i].a == l[i-1].a && l[i].b == l[i-1].b )
+            continue; // Duplicate
+
+        if ( ases.empty() || ases.back() != l[i].a )
+        {
+            ases.push_back( l[i].a );
+            offsets.push_back( neighbors.size() );
+        }
+
+        neighbors.push_back( l[i].b ); // AS number for now, identifier below
+        relationships.push_back( static_cast< signed char >( l[i].relationship ) );
+    }
+
+    offsets.push_back( neighbors.size() );
+
+    for ( size_t i = 0; i < neighbors.size(); ++i )
+        neighbors[i] = id( neighbors[i] ); // Every b is also an a, and ids keep the order of AS numbers
+}
+
+// Depth-first search of the P2C links from each AS
+void GraphIndex::computeCones()
+{
+    const size_t n = ases.size();
+    vector< uint32_t > stamp( n, 0 );
+    vector< uint32_t > stack;
+    vector< uint32_t > cone;
+
+    coneOffsets.resize( n );
+    coneSizes.resize( n );
+
+    for ( uint32_t i = 0; i < n; ++i )
+    {
+        cone.clear();
+        stack.push_back( i );
+        stamp[i] = i + 1;
+
+        while ( !stack.empty() )
+        {
+            const uint32_t x = stack.back();
+            stack.pop_back();
+            cone.push_back( x );
+
+            for ( uint32_t k = offsets[x]; k < offsets[x+1]; ++k )
+                if ( relationships[k] == P2C && stamp[neighbors[k]] != i + 1 )
+                {
+                    stamp[neighbors[k]] = i + 1;
+                    stack.push_back( neighbors[k] );
+                }
+        }
+
+        storeCone( i, cone );
+    }
+}
+
+// Stores the cone of identifier i, given as distinct identifiers in any order
+// Cones with more than 1 member in 32 are stored as bitmaps
+void GraphIndex::storeCone( uint32_t i, vector< uint32_t >& cone )
+{
+    const size_t n = ases.size();
+    const size_t words = ( n + 63 ) / 64;
+
+    coneSizes[i] = cone.size();
+
+    if ( cone.size() * 32 > n )
+    {
+        coneOffsets[i] = coneBitmaps.size() | bitmapFlag;
+        coneBitmaps.resize( coneBitmaps.size() + words, 0 );
+        uint64_t* bitmap = &coneBitmaps[coneBitmaps.size() - words];
+        for ( size_t k = 0; k < cone.size(); ++k )
+            bitmap[cone[k] / 64] |= uint64_t( 1 ) << ( cone[k] % 64 );
+    }
+    else
+    {
+        sort( cone.begin(), cone.end() );
+        coneOffsets[i] = coneMembers.size();
+        coneMembers.insert( coneMembers.end(), cone.begin(), cone.end() );
+    }
+}
+
+size_t GraphIndex::id( AS a ) const
+{
+    vector< AS >::const_iterator it = lower_bound( ases.begin(), ases.end(), a );
+    return it != ases.end() && *it == a ? it - ases.begin() : ases.size();
+}
+
+bool GraphIndex::contains( AS a ) const
+{
+    return id( a ) != ases.size();
+}
+
+bool GraphIndex::relationship( AS a, AS b, TypeOfRelationship& t ) const
+{
+    const size_t i = id( a ), j = id( b );
+    if ( i == ases.size() || j == ases.size() )
+        return false;
+
+    const uint32_t* begin = &neighbors[0] + offsets[i];
+    const uint32_t* end = &neighbors[0] + offsets[i+1];
+    const uint32_t* it = lower_bound( begin, end, static_cast< uint32_t >( j ) );
+    if ( it == end || *it != j )
+        return false;
+
+    t = static_cast< TypeOfRelationship >( relationships[it - &neighbors[0]] );
+    return true;
+}
+
+bool GraphIndex::inCustomerCone( AS x, AS y ) const
+{
+    const size_t i = id( x ), j = id( y );
+    if ( i == ases.size() || j == ases.size() )
+        return false;
+
+    if ( coneOffsets[j] & bitmapFlag )
+        return ( coneBitmaps[( coneOffsets[j] & ~bitmapFlag ) + i / 64] >> ( i % 64 ) ) & 1;
+
+    const uint32_t* begin = &coneMembers[0] + coneOffsets[j];
+    return binary_search( begin, begin + coneSizes[j], static_cast< uint32_t >( i ) );
+}
+
+size_t GraphIndex::customerConeSize( AS y ) const
+{
+    const size_t j = id( y );
+    return j == ases.size() ? 0 : coneSizes[j];
+}
+
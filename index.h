@@ -0,0 +1,62 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "data.h"
+
+/*
+ * GraphIndex --> Immutable snapshot of an inferred graph, for queries
+ *
+ *      ases (sorted vector of AS) [the position of an AS is its identifier]
+ *      adjacency (CSR) [neighbors of each AS, sorted, with the relationship from its point of view]
+ *      customer cones (CSR or bitmap) [sorted members of each cone, as a bitmap when it is denser]
+ *
+ * The customer cones of a snapshot of Data are those of the Data, so that sizes match
+ * --cone-sizes (exact ones with approximate cones, which --cone-sizes estimates). Those of
+ * a CAIDA file are computed from its P2C links (an AS is in its own cone).
+ * An index is never modified once built, so any number of threads may query it.
+ */
+
+class GraphIndex
+{
+public:
+    GraphIndex( const Data& data );
+    GraphIndex( const string& relFile ); // CAIDA format (cf io.h)
+
+    size_t size() const { return ases.size(); }
+    size_t links() const { return neighbors.size() / 2; }
+
+    bool contains( AS a ) const;
+    bool relationship( AS a, AS b, TypeOfRelationship& t ) const; // false if a and b are not linked
+    bool inCustomerCone( AS x, AS y ) const; // x is in the customer cone of y
+    size_t customerConeSize( AS y ) const;
+
+private:
+    void build( vector< Link >& l );
+    void computeCones();
+    void storeCone( uint32_t i, vector< uint32_t >& cone );
+    size_t id( AS a ) const; // size() if not found
+
+    vector< AS > ases;
+    vector< uint32_t > offsets;
+    vector< uint32_t > neighbors;
+    vector< signed char > relationships;
+
+    vector< uint64_t > coneOffsets; // Into coneMembers, or into coneBitmaps (last bit set)
+    vector< uint32_t > coneSizes;
+    vector< uint32_t > coneMembers;
+    vector< uint64_t > coneBitmaps;
+};
+
+#endif
+
@@ -7,26 +7,34 @@
 */
 
 #include "inference.h"
+#include "parallel.h"
 #include <algorithm>
 
 // Computes a clique of central AS
-// First finds the biggest clique amongst the 10 AS of largest transit degree
-// Then adds ASs such that the whole remains a clique
 // Computes AS transit degrees by constructing a temporary Data (almost doubles run time)
-// Possible improvement: use known relationships to exclude ASs with providers
-set< AS > computeClique( const vector< string >& dataFiles, const set< AS >& ixp )
+set< AS > computeClique( const vector< string >& dataFiles, const set< AS >& ixp, const Options& options )
 {
-    Data data( dataFiles, vector< string >(), ixp, set< AS >() );
+    Data data( dataFiles, vector< string >(), ixp, set< AS >(), options );
 
+    return computeClique( data );
+}
+
+// Computes a clique of central AS from data initialized without clique
+// First finds the biggest clique amongst the data.options.cliqueCandidates (10 by default) AS of largest transit degree
+// Then adds ASs such that the whole remains a clique
+// Possible improvement: use known relationships to exclude ASs with providers
+set< AS > computeClique( const Data& data )
+{
     set< AS > clique;
     const vector< AS >& asByRank = data.asByRank;
+    const unsigned int candidates = min< size_t >( min( data.options.cliqueCandidates, 20u ), asByRank.size() );
 
-    for ( unsigned short int s = 0; s < 1<<10; ++s ) // Subsets of [1..10] are represented as 10 bit integers
+    for ( unsigned int s = 0; s < 1u<<candidates; ++s ) // Subsets of [1..candidates] are represented as bit sets
     {
         set< AS > candidateSet;
         bool valid = true;
 
-        for ( unsigned char e = 0; e < 10; ++e )
+        for ( unsigned char e = 0; e < candidates; ++e )
             if ( (s>>e) % 2 )
                 candidateSet.insert( asByRank[e] );
         
@@ -42,7 +50,7 @@ set< AS > computeClique( const vector< string >& dataFiles, const set< AS >& ixp
             clique = candidateSet;
     }
 
-    for ( unsigned int i = 10; i < asByRank.size(); ++i )
+    for ( unsigned int i = candidates; i < asByRank.size(); ++i )
     {
         bool add = true;
         for ( set< AS >::iterator it = clique.begin(); it != clique.end() && add; ++it )
@@ -56,20 +64,40 @@ set< AS > computeClique( const vector< string >& dataFiles, const set< AS >& ixp
     return clique;
 }
 
+// Helper structure
+// Link x>y to assign in function topDown, because of the triplet w x y (w is 0 if none, cf Data::evidence)
+// Ordered by x then y only, as pairs: a set keeps the w of the triplet that first added the link
+struct TopDownLink
+{
+    AS x;
+    AS y;
+    AS w;
+
+    bool operator<( const TopDownLink& l ) const { return x != l.x ? x < l.x : y < l.y; }
+};
+
+// Helper function
+inline TopDownLink topDownLink( AS x, AS y, AS w )
+{
+    const TopDownLink l = { x, y, w };
+    return l;
+}
+
 // Helper function
 // Top-down inference when assigning non-gradient complient links
 // p2cCandidates contains the non-grandient complient links to assign
 // The links in p2cCandidates are not all set first; some may be rejected due to intermediate assignments
-void topDown( Data& data, set< pair< AS, AS > >& p2cCandidates )
+void topDown( Data& data, set< TopDownLink >& p2cCandidates )
 {
     while ( !p2cCandidates.empty() )
     {
-        set< pair< AS, AS > >::iterator edge = p2cCandidates.begin();
-        const AS x = edge->first;
-        const AS y = edge->second;
+        set< TopDownLink >::iterator edge = p2cCandidates.begin();
+        const AS x = edge->x;
+        const AS y = edge->y;
+        const AS w = edge->w;
         p2cCandidates.erase( edge );
 
-        if ( data.setRelationship( x, y, P2C ) )
+        if ( data.setRelationship( x, y, P2C, w ) )
         {
             const unsigned int rY = data[y].rank;
             LinkData& linkData = data[x][y];
@@ -79,15 +107,17 @@ void topDown( Data& data, set< pair< AS, AS > >& p2cCandidates )
                 const AS z = it->first;
                 ASData& dZ = data[z];
                 if ( rY < dZ.rank && dZ[y][x].upstream )
-                    p2cCandidates.insert( make_pair( y, z ) );                  
+                    p2cCandidates.insert( topDownLink( y, z, x ) );                  
             }
         }
     }
 }
 
-// Infers relationship where x>y?z, x-y?z or x?y-z (in the last case, only if the triplet is seen at least 3 times)
+// Infers relationship where x>y?z, x-y?z or x?y-z (in the last case, only if the triplet is seen more than data.options.peerTripletCount times)
 void addUpstreamProviderLinks( Data& data )
 {
+    const unsigned int peerTripletCount = data.options.peerTripletCount;
+
     for ( unsigned int i = 0; i < data.asByRank.size(); ++i )
     {
         const AS z = data.asByRank[i];
@@ -96,7 +126,7 @@ void addUpstreamProviderLinks( Data& data )
         if ( dZ.inClique )
             continue;
 
-        for ( map< AS, LinkData >::iterator it = dZ.begin(); it != dZ.end(); ++it )
+        for ( ASData::iterator it = dZ.begin(); it != dZ.end(); ++it )
         {
             const AS y = it->first;
             LinkData& link = it->second;
@@ -104,15 +134,15 @@ void addUpstreamProviderLinks( Data& data )
             if ( data[y].rank > dZ.rank || dZ[y].relationship != UNKNOWN )
                 continue;
 
-            for ( map< AS, TripletData >::iterator jt = link.begin(); jt != link.end(); ++jt )
+            for ( LinkData::iterator jt = link.begin(); jt != link.end(); ++jt )
             {
                 const AS x = jt->first;
                 TripletData& triplet = jt->second;
                 TypeOfRelationship t = data[x][y].relationship;
 
-                if ( ( t == P2C && triplet.upstream ) || ( t == P2P && ( triplet.upstream || triplet.count > 2 ) ) ) // Why 2 ?
+                if ( ( t == P2C && triplet.upstream ) || ( t == P2P && ( triplet.upstream || triplet.count > peerTripletCount ) ) ) // Why 2 ?
                 {
-                    data.setRelationship( y, z, P2C );
+                    data.setRelationship( y, z, P2C, x );
                     break;
                 }
             }
@@ -120,15 +150,203 @@ void addUpstreamProviderLinks( Data& data )
     }
 }
 
+// Helper function
+// Number of threads of the parallel passes, 1 if they run serially (cf Options::threads)
+// Passes run serially when evidence is recorded, so that the log does not depend on the number of threads
+inline unsigned int inferenceThreads( const Data& data )
+{
+    return data.options.recordEvidence ? 1 : min( data.options.threads, Arena::lanes );
+}
+
+typedef vector< pair< AS, AS > > LinkBatch;
+
+// Helper structure
+// Parallel setting of P2C links p>s from transit ASs p to stubs s (transit degree 0), in three rounds (cf parallel.h):
+//  1. every thread considers candidate links, batched by owner of p
+//  2. owners of p set p>s unless already set or s is in the provider cone of p, and batch the updates of other ASs
+//  3. owners of s set s<p and extend the provider cone of s; owners of the providers of p extend their customer cone
+// Same result as setting the links serially, in any order, as long as no stub s has a customer: the customer cone
+// of s is then s itself, so the cones read (those of p) are not changed by the pass. Otherwise nothing is set.
+struct StubLinks
+{
+    StubLinks( Data& data, unsigned int threads );
+
+    void consider( unsigned int t, AS p, AS s ); // Round 1, by thread t: p>s is a candidate if s is a stub
+    bool set(); // Rounds 2 and 3, false if a candidate was not safe (nothing is set then)
+    void orient( unsigned int u ); // Round 2, by thread u
+    void apply( unsigned int u ); // Round 3, by thread u
+
+    Data& data;
+    const unsigned int threads;
+    vector< vector< LinkBatch > > candidates; // [t][u] candidates p>s of thread t, p owned by u
+    vector< vector< LinkBatch > > stubs; // [t][u] links p>s set by thread t, s owned by u
+    vector< vector< LinkBatch > > cones; // [t][u] pairs q s, s joins the customer cone of q owned by u
+    vector< char > unsafe; // [t]
+};
+
+// Helper functor
+// Round 2 of StubLinks
+struct OrientStubLinks
+{
+    OrientStubLinks( StubLinks& l ) : links( l ) {}
+    StubLinks& links;
+
+    void operator()( unsigned int u ) const { links.orient( u ); }
+};
+
+// Helper functor
+// Round 3 of StubLinks
+struct ApplyStubLinks
+{
+    ApplyStubLinks( StubLinks& l ) : links( l ) {}
+    StubLinks& links;
+
+    void operator()( unsigned int u ) const { links.apply( u ); }
+};
+
+StubLinks::StubLinks( Data& d, unsigned int n )
+    : data( d ), threads( n ), candidates( n, vector< LinkBatch >( n ) ), stubs( n, vector< LinkBatch >( n ) ), cones( n, vector< LinkBatch >( n ) ), unsafe( n, false )
+{
+}
+
+void StubLinks::consider( unsigned int t, AS p, AS s )
+{
+    Data::const_iterator dS = data.find( s );
+    if ( dS != data.end() && dS->second.transitDegree != 0 )
+        return;
+
+    Data::const_iterator dP = data.find( p );
+    bool safe = dS != data.end() && dP != data.end() && dP->second.transitDegree != 0 && dP->second.count( s ) != 0 && dS->second.count( p ) != 0;
+
+    if ( safe )
+        for ( ASData::const_iterator it = dS->second.begin(); safe && it != dS->second.end(); ++it )
+            safe = it->second.relationship != P2C;
+
+    if ( safe )
+        candidates[t][owner( p, threads )].push_back( make_pair( p, s ) );
+    else
+        unsafe[t] = true;
+}
+
+bool StubLinks::set()
+{
+    if ( find( unsafe.begin(), unsafe.end(), true ) != unsafe.end() )
+        return false;
+
+    parallel( threads, OrientStubLinks( *this ) );
+    parallel( threads, ApplyStubLinks( *this ) );
+
+    // Sketches of providers are shared by the cones of several threads: they are merged once all links are set
+    if ( data.conesInitialized && data.options.approximateCones != 0 )
+    {
+        vector< AS > providers;
+
+        for ( unsigned int t = 0; t < threads; ++t )
+            for ( unsigned int u = 0; u < threads; ++u )
+                for ( LinkBatch::const_iterator it = stubs[t][u].begin(); it != stubs[t][u].end(); ++it )
+                {
+                    providerConeFromLinks( data, it->first, providers );
+                    data.addToConeSketches( providers, it->second );
+                }
+    }
+
+    return true;
+}
+
+void StubLinks::orient( unsigned int u )
+{
+    const bool exactCones = data.conesInitialized && data.options.approximateCones == 0;
+
+    for ( unsigned int t = 0; t < threads; ++t )
+        for ( LinkBatch::const_iterator it = candidates[t][u].begin(); it != candidates[t][u].end(); ++it )
+        {
+            ASData& dP = data.find( it->first )->second;
+            LinkData& dPS = dP.find( it->second )->second;
+
+            // Empty provider cone with approximate cones: s has no customer, hence is not a provider of p anyway
+            if ( dPS.relationship != UNKNOWN || dP.providerCone.count( it->second ) != 0 )
+                continue;
+
+            dPS.relationship = P2C;
+            dPS.inCones = data.conesInitialized;
+            stubs[u][owner( it->second, threads )].push_back( *it );
+
+            if ( exactCones )
+                for ( pmr::set< AS >::const_iterator qt = dP.providerCone.begin(); qt != dP.providerCone.end(); ++qt )
+                    cones[u][owner( *qt, threads )].push_back( make_pair( *qt, it->second ) );
+        }
+}
+
+void StubLinks::apply( unsigned int u )
+{
+    for ( unsigned int t = 0; t < threads; ++t )
+    {
+        for ( LinkBatch::const_iterator it = stubs[t][u].begin(); it != stubs[t][u].end(); ++it )
+        {
+            ASData& dS = data.find( it->second )->second;
+            LinkData& dSP = dS.find( it->first )->second;
+
+            dSP.relationship = C2P;
+            dSP.inCones = data.conesInitialized;
+
+            if ( data.conesInitialized && data.options.approximateCones != 0 )
+                dS.providers.push_back( it->first );
+            else if ( data.conesInitialized )
+            {
+                const ASData& dP = data.find( it->first )->second;
+                dS.providerCone.insert( dP.providerCone.begin(), dP.providerCone.end() );
+            }
+        }
+
+        for ( LinkBatch::const_iterator it = cones[t][u].begin(); it != cones[t][u].end(); ++it )
+            data.find( it->first )->second.customerCone.insert( it->second );
+    }
+}
+
+// Helper functor
+// Round 1 of findClientStubsSeenFromPartialVP, thread t considers the links of partial VPs t, t + n, t + 2n...
+struct ConsiderPartialVPStubs
+{
+    ConsiderPartialVPStubs( StubLinks& l, const vector< Data::const_iterator >& v ) : links( l ), vps( v ) {}
+    StubLinks& links;
+    const vector< Data::const_iterator >& vps;
+
+    void operator()( unsigned int t ) const
+    {
+        for ( size_t i = t; i < vps.size(); i += links.threads )
+            for ( ASData::const_iterator jt = vps[i]->second.begin(); jt != vps[i]->second.end(); ++jt )
+                for ( LinkData::const_iterator kt = jt->second.begin(); kt != jt->second.end(); ++kt )
+                    if ( kt->second.twoEdgePath )
+                        links.consider( t, jt->first, kt->first );
+    }
+};
+
 // Infer P2C links to stub ASs as 2 hops of a partial VP (one that does not give us a full view)
+// Runs in parallel if data.options.threads > 1 (cf StubLinks)
 void findClientStubsSeenFromPartialVP( Data& data )
 {
+    const unsigned int threads = inferenceThreads( data );
+
+    if ( threads > 1 )
+    {
+        vector< Data::const_iterator > vps;
+        for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+            if ( it->second.visibilityAsVP.size() * data.options.partialVPRatio < data.size() )
+                vps.push_back( it );
+
+        StubLinks links( data, threads );
+        parallel( threads, ConsiderPartialVPStubs( links, vps ) );
+
+        if ( links.set() )
+            return;
+    }
+
     for ( Data::iterator it = data.begin(); it != data.end(); ++it )
-        if ( it->second.visibilityAsVP.size() * 50 < data.size() ) // visibility < 2%
+        if ( it->second.visibilityAsVP.size() * data.options.partialVPRatio < data.size() ) // visibility < 2% by default
             for ( ASData::iterator jt = it->second.begin(); jt != it->second.end(); ++jt )
                 for ( LinkData::iterator kt = jt->second.begin(); kt != jt->second.end(); ++kt )
                     if ( kt->second.twoEdgePath && data[kt->first].transitDegree == 0 )
-                        data.setRelationship( jt->first, kt->first, P2C );
+                        data.setRelationship( jt->first, kt->first, P2C, it->first );
 }
 
 // Helper structure
@@ -172,12 +390,12 @@ void addLinksToSmallerProviders( Data& data )
         const Triplet t = cI->second;
         candidates.erase( cI );
 
-        if ( priority > 2 ) // Why 2 ?
+        if ( priority > data.options.smallerProviderCount ) // Why 2 ?
         {
-            if ( data.setRelationship( t.y, t.z, P2C ) ) // Propagation
+            if ( data.setRelationship( t.y, t.z, P2C, t.x ) ) // Propagation
             {
                 LinkData& linkYZ = data[t.y][t.z];
-                set< pair< AS, AS > > nextInLine;
+                set< TopDownLink > nextInLine;
 
                 for ( LinkData::iterator it = linkYZ.begin(); it != linkYZ.end(); ++it )
                 {
@@ -187,7 +405,7 @@ void addLinksToSmallerProviders( Data& data )
                         const Triplet tI = { it->first, t.z, t.y };
 
                         if ( data[it->first].rank > data[t.z].rank ) // Top-down
-                            nextInLine.insert( make_pair( t.y, t.z ) );
+                            nextInLine.insert( topDownLink( t.y, t.z, t.x ) );
                         else if ( linkIZ[t.y].endOfPath ) // SmallerProvider
                             candidates.insert( make_pair( linkIZ[t.y].count, tI ) );
                     }
@@ -205,11 +423,18 @@ struct rankCompare
 {
     rankCompare( const Data& data ) : d( data ) {}
 
-    bool operator() ( AS a, AS b ) { return d.at( a ).rank < d.at( b ).rank; }
+    bool operator() ( AS a, AS b ) const { return d.at( a ).rank < d.at( b ).rank; }
 
     const Data& d;
 };
 
+// Helper function
+// The provider cone of x is x itself
+inline bool withoutProvider( const Data& data, const ASData& dX )
+{
+    return data.options.approximateCones == 0 ? dX.providerCone.size() == 1 : dX.providers.empty();
+}
+
 // Orients triplets x?y?z when y has no provider
 void breakTiesWhenNoProvider( Data& data )
 {
@@ -219,9 +444,9 @@ void breakTiesWhenNoProvider( Data& data )
         const AS x = data.asByRank[i];
         ASData& dX = data[x];
 
-        if ( dX.providerCone.size() == 1
+        if ( withoutProvider( data, dX )
             && !dX.inClique
-            && dX.transitDegree >= 10 ) // Wy 10 ?
+            && dX.transitDegree >= data.options.noProviderTransitDegree ) // Wy 10 ?
         {
             set< AS, rankCompare > neighbors( compare );
             for ( ASData::iterator it = dX.begin(); it != dX.end(); ++it )
@@ -236,9 +461,9 @@ void breakTiesWhenNoProvider( Data& data )
 
                 data.setRelationship( x, y, P2P );
 
-                set< pair< AS, AS > > nextInLine;
+                set< TopDownLink > nextInLine;
                 for ( LinkData::iterator it = dXY.begin(); it != dXY.end(); ++it )
-                    nextInLine.insert( make_pair( y, it->first ) );
+                    nextInLine.insert( topDownLink( y, it->first, x ) );
 
                 topDown( data, nextInLine );
             }
@@ -246,11 +471,49 @@ void breakTiesWhenNoProvider( Data& data )
     }
 }
 
+// Helper functor
+// Round 1 of setCliqueStubLinksAsP2C, thread t considers the links of clique ASs t, t + n, t + 2n...
+struct ConsiderCliqueStubs
+{
+    ConsiderCliqueStubs( StubLinks& l, const vector< AS >& c ) : links( l ), clique( c ) {}
+    StubLinks& links;
+    const vector< AS >& clique;
+
+    void operator()( unsigned int t ) const
+    {
+        for ( size_t i = t; i < clique.size(); i += links.threads )
+        {
+            Data::const_iterator dC = links.data.find( clique[i] );
+            if ( dC == links.data.end() )
+            {
+                links.unsafe[t] = true;
+                continue;
+            }
+
+            for ( ASData::const_iterator st = dC->second.begin(); st != dC->second.end(); ++st )
+                links.consider( t, clique[i], st->first );
+        }
+    }
+};
+
 // Infer clique-stub P2C relationships (implies no triplet x-y?z was seen with x, y in clique and z a stub) 
 // Passing clique as an argument avoids having to loop over all ASs to find clique ASs
 // This second argument could be removed; performance impact is negligeable
+// Runs in parallel if data.options.threads > 1 (cf StubLinks)
 void setCliqueStubLinksAsP2C( Data& data, const set< AS >& clique )
 {
+    const unsigned int threads = inferenceThreads( data );
+
+    if ( threads > 1 )
+    {
+        const vector< AS > members( clique.begin(), clique.end() );
+        StubLinks links( data, threads );
+        parallel( threads, ConsiderCliqueStubs( links, members ) );
+
+        if ( links.set() )
+            return;
+    }
+
     for ( set< AS >::const_iterator ct = clique.begin(); ct != clique.end(); ++ct )
     {
         ASData& dC = data[*ct];
@@ -275,13 +538,20 @@ void breakRemainingTies( Data& data )
         set< AS > upstream;
         set< AS > downstream;
 
-        for ( set< pair< AS, AS > >::iterator it = dY.transitPairs.begin(); it != dY.transitPairs.end(); ++it )
+        vector< AS > providers; // Provider cone of y, sorted, with approximate cones
+        if ( data.options.approximateCones != 0 )
+        {
+            providerConeFromLinks( data, y, providers );
+            sort( providers.begin(), providers.end() );
+        }
+
+        for ( pmr::set< pair< AS, AS > >::iterator it = dY.transitPairs.begin(); it != dY.transitPairs.end(); ++it )
         {
             LinkData& dXY = data[it->first][y];
 
             bool skip = false;
             for ( LinkData::iterator jt = dXY.begin(); jt != dXY.end() && !skip; ++jt )
-                if ( dY.providerCone.count( jt->first ) != 0 )
+                if ( data.options.approximateCones == 0 ? dY.providerCone.count( jt->first ) != 0 : binary_search( providers.begin(), providers.end(), jt->first ) )
                     skip = true;
 
             if ( skip )
@@ -292,25 +562,59 @@ void breakRemainingTies( Data& data )
             downstream.insert( it->second );
         }
 
-        for ( set< pair< AS, AS > >::iterator it = candidates.begin(); it != candidates.end(); ++it )
+        for ( set< pair< AS, AS > >::iterator it = candidates.begin(); it != candidates.end(); )
             if ( upstream.count( it->second ) != 0 || downstream.count( it->first ) != 0 )
-                candidates.erase( it-- );
+                candidates.erase( it++ ); // it-- on the first candidate was undefined
+            else
+                ++it;
 
-        set< pair< AS, AS > > nextInLine; 
+        set< TopDownLink > nextInLine; 
         for ( set< pair< AS, AS > >::iterator it = candidates.begin(); it != candidates.end(); ++it )
         {
             const AS z = it->second;
             if ( dY.rank < data[z].rank )
-                nextInLine.insert( make_pair( y, z ) );
+                nextInLine.insert( topDownLink( y, z, it->first ) );
         }
 
         topDown( data, nextInLine );
     }
 }
 
+// Helper functor
+// Parallel completeWithP2PLinks, thread t sets the links of ASs t, t + n, t + 2n... (each side of a link by its own AS)
+// Same result as the serial pass since relationships are symmetric: Data[x][y] is unknown iff Data[y][x] is
+struct CompleteWithP2PLinks
+{
+    CompleteWithP2PLinks( const vector< ASData* >& a, unsigned int n ) : ases( a ), threads( n ) {}
+    const vector< ASData* >& ases;
+    const unsigned int threads;
+
+    void operator()( unsigned int t ) const
+    {
+        for ( size_t i = t; i < ases.size(); i += threads )
+            for ( ASData::iterator jt = ases[i]->begin(); jt != ases[i]->end(); ++jt )
+                if ( jt->second.relationship == UNKNOWN )
+                    jt->second.relationship = P2P;
+    }
+};
+
 // Set all unoriented edges to P2P
+// Runs in parallel if data.options.threads > 1
 void completeWithP2PLinks( Data& data )
 {
+    const unsigned int threads = inferenceThreads( data );
+
+    if ( threads > 1 )
+    {
+        vector< ASData* > ases;
+        ases.reserve( data.size() );
+        for ( Data::iterator it = data.begin(); it != data.end(); ++it )
+            ases.push_back( &it->second );
+
+        parallel( threads, CompleteWithP2PLinks( ases, threads ) );
+        return;
+    }
+
     for ( Data::iterator it = data.begin(); it != data.end(); ++it )
         for ( ASData::iterator jt = it->second.begin(); jt != it->second.end(); ++jt )
             data.setRelationship( it->first, jt->first, P2P );
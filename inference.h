@@ -14,7 +14,8 @@
 #include <string>
 #include "data.h"
 
-set< AS > computeClique( const vector< string >& dataFiles, const set< AS >& ixp );
+set< AS > computeClique( const vector< string >& dataFiles, const set< AS >& ixp, const Options& options = Options() );
+set< AS > computeClique( const Data& data );
 void addUpstreamProviderLinks( Data& data );
 void findClientStubsSeenFromPartialVP( Data& data );
 void addLinksToSmallerProviders( Data& data );
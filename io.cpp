@@ -7,9 +7,16 @@
 */
 
 #include "io.h"
+#include "external.h"
+#include "pipeline.h"
+#include "cones.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <stdexcept>
 
 ///////////////////////////////////
 // Input format detailed in io.h //
@@ -100,37 +107,125 @@ void loadRelationships( const vector< string >& relFiles, Data& data )
 
 // Extracts an AS path from a string stream
 // 'is' is expected to contain the AS numbers seperated by spaces
-void extractPath( istringstream& is, Data& data, const set< AS > ixp , const set< AS >& clique )
+// IXPs and prepended ASs are removed; returns false if the path must be discarded (cf acceptPath)
+bool readPath( istringstream& is, vector< AS >& asPath, const set< AS >& ixp, const set< AS >& clique )
 {
-    vector< AS > asPath;
     AS as;
 
+    asPath.clear();
+
     while ( is >> as )
         if ( ixp.count( as ) == 0 )
             if ( asPath.size() == 0 || asPath.back() != as )
                 asPath.push_back( as );
 
+    return acceptPath( asPath, as, clique );
+}
+
+// Same as readPath, for a path given as an array of AS numbers
+bool readPath( const AS* path, size_t length, vector< AS >& asPath, const set< AS >& ixp, const set< AS >& clique )
+{
+    asPath.clear();
+
+    for ( size_t i = 0; i < length; ++i )
+        if ( ixp.count( path[i] ) == 0 )
+            if ( asPath.size() == 0 || asPath.back() != path[i] )
+                asPath.push_back( path[i] );
+
+    return acceptPath( asPath, length != 0 ? path[length-1] : 0, clique );
+}
+
+// Splits a prefix|path line: begin moves to the path
+// Returns true if the line starts with an IPv4 prefix, stored in network and length
+bool readPrefix( const char*& begin, const char* end, uint32_t& network, unsigned char& length )
+{
+    const char* const bar = find( begin, end, '|' );
+    if ( bar == end )
+        return false;
+
+    const bool valid = parsePrefix( begin, bar, network, length );
+    begin = bar + 1;
+    return valid;
+}
+
+// Fast version of readPath for lines only made of AS numbers and blanks, without the checks of acceptPath
+// Returns false if the line contains anything else; it must then be read by readPath
+bool tokenizePath( const char* it, const char* end, vector< AS >& asPath, AS& last, const set< AS >& ixp )
+{
+    asPath.clear();
+
+    while ( it != end )
+    {
+        const char c = *it;
+
+        if ( c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f' )
+        {
+            ++it;
+            continue;
+        }
+
+        if ( c < '0' || c > '9' )
+            return false;
+
+        unsigned long long as = 0;
+        while ( it != end && *it >= '0' && *it <= '9' )
+        {
+            as = 10 * as + ( *it++ - '0' );
+            if ( as > UINT_MAX )
+                return false;
+        }
+
+        last = as;
+        if ( ixp.count( last ) == 0 )
+            if ( asPath.size() == 0 || asPath.back() != last )
+                asPath.push_back( last );
+    }
+
+    return true;
+}
+
+// Completes a path read by readPath, given the last AS number read ('last', kept even if it is an IXP)
+// Returns false if the path must be discarded (loop, clique ASs not consecutive or too short)
+// Loops are found by sorting a copy of the path, which avoids allocating a set per path
+bool acceptPath( vector< AS >& asPath, AS last, const set< AS >& clique )
+{
     if ( asPath.empty() )
-        return;
+        return false;
 
-    if ( asPath.back() != as )
-        asPath.push_back( as ); // IXP at end of path
+    if ( asPath.back() != last )
+        asPath.push_back( last ); // IXP at end of path
 
     unsigned int size = asPath.size();
 
     unsigned int c = 0;
-    set< AS > visitedAS;
     for ( unsigned int i = 0; i < size; ++i )
-    {
-        visitedAS.insert( asPath[i] );
         if ( clique.count( asPath[i] ) != c % 2 )
             ++c;
+
+    if ( c > 2 || size < 2 )
+        return false; // Non-consecutive clique AS in path
+
+    AS local[32];
+    vector< AS > large;
+    AS* sorted = local;
+
+    if ( size > 32 )
+    {
+        large.resize( size );
+        sorted = &large[0];
     }
 
-    if ( c > 2 || visitedAS.size() != size || size < 2 )
-        return; // Loops or non-consecutive clique AS in path
+    copy( asPath.begin(), asPath.end(), sorted );
+    sort( sorted, sorted + size );
+
+    return adjacent_find( sorted, sorted + size ) == sorted + size; // Loops
+}
+
+// Adds an accepted AS path (cf readPath) to data
+void addPath( const vector< AS >& asPath, Data& data )
+{
+    unsigned int size = asPath.size();
 
-    // Accept path
     ASData& data0 = data[asPath[0]];
     data0.visibilityAsVP.insert( asPath[size-1] );
     data0[asPath[1]];
@@ -190,11 +285,25 @@ void extractPath( istringstream& is, Data& data, const set< AS > ixp , const set
 }
 
 // Loads paths from pathFiles into data
+// If data.options.spillBuffer is not 0, triplets are spilled and merged (cf external.h) in buffers of about spillBuffer bytes
+// Otherwise, if data.options.threads is more than 1, files are loaded by a pipeline of threads (cf pipeline.h)
+// Only paths from data.vantagePoints are loaded, unless it is empty (cf sample.h)
 void loadPaths( const vector< string >& pathFiles, Data& data, const set< AS > ixp , const set< AS >& clique )
 {
+    const size_t spillBuffer = data.options.spillBuffer;
     ifstream fs;
+    vector< AS > asPath;
+    RecordSorter sorter( spillBuffer );
 
     data.clear();
+    data.prefixes.clear();
+
+    if ( spillBuffer == 0 && data.options.threads > 1 )
+    {
+        loadPathsPipelined( pathFiles, data, ixp, clique, data.options.threads );
+        data.prefixes.compact();
+        return;
+    }
 
     for ( unsigned int i = 0; i < pathFiles.size(); ++i )
     {
@@ -206,13 +315,35 @@ void loadPaths( const vector< string >& pathFiles, Data& data, const set< AS > i
         {
             if ( !line.empty() && line.find( '#' ) == string::npos )
             {
-                istringstream is( line );
-                extractPath( is, data, ixp, clique );
+                const char* path = line.data();
+                uint32_t network;
+                unsigned char length;
+                const bool prefixed = readPrefix( path, line.data() + line.size(), network, length );
+
+                istringstream is( line.substr( path - line.data() ) );
+                if ( !readPath( is, asPath, ixp, clique ) )
+                    continue;
+
+                if ( !data.vantagePoints.empty() && data.vantagePoints.count( asPath[0] ) == 0 )
+                    continue;
+
+                if ( prefixed )
+                    data.prefixes.add( asPath.back(), network, length );
+
+                if ( spillBuffer != 0 )
+                    sorter.addPath( asPath );
+                else
+                    addPath( asPath, data );
             }
         }
 
         fs.close();
     }
+
+    if ( spillBuffer != 0 )
+        sorter.merge( data );
+
+    data.prefixes.compact();
 }
 
 // Output infered relationships
@@ -230,3 +361,153 @@ void printGraph( const Data& data, const set< AS >& clique )
                 cout << it->first << '|' << jt->first << '|' << static_cast<int>( jt->second.relationship ) << endl;
 }
 
+// Helper function
+// Reads the next relationship of a CAIDA file, skipping comments and blank lines
+// Returns false at the end of the file
+bool readRelationship( istream& fs, AS& a, AS& b, int& t )
+{
+    char peek;
+
+    while ( ( peek = fs.peek() ) != eof )
+    {
+        switch ( peek )
+        {
+            case ' ':
+            case '\n':
+                fs.ignore();
+                break;
+            case '#':
+                fs.ignore( numeric_limits< streamsize >::max(), '\n' );
+                break;
+            default:
+                fs >> a;
+                fs.ignore();
+                fs >> b;
+                fs.ignore();
+                fs >> t;
+                if ( !fs )
+                    throw runtime_error( "malformed relationship" );
+                return true;
+        }
+    }
+
+    return false;
+}
+
+// Helper structure
+// Reads the relationships of a CAIDA file one at a time, as links a < b (a line b|a|r is read as a|b|-r for P2C and C2P)
+// Links must be sorted by (a, b) once oriented so, as printGraph writes them
+struct RelationshipStream
+{
+    RelationshipStream( const string& f ) : file( f ), fs( f.c_str() ), valid( true ), link( 0, 0 ), t( 0 )
+    {
+        if ( !fs )
+            throw runtime_error( "cannot open " + file );
+        next();
+    }
+
+    void next()
+    {
+        const pair< AS, AS > previous = link;
+
+        valid = readRelationship( fs, link.first, link.second, t );
+        if ( !valid )
+            return;
+
+        if ( link.first > link.second )
+        {
+            swap( link.first, link.second );
+            if ( t == P2C || t == C2P )
+                t = -t;
+        }
+
+        if ( link <= previous )
+            throw runtime_error( file + " is not sorted by (a, b) with a < b" );
+    }
+
+    const string file;
+    ifstream fs;
+    bool valid;
+    pair< AS, AS > link;
+    int t;
+};
+
+// Output the differences between inferred relationships and those of previousFile (CAIDA format, sorted by (a, b) with a < b, as printGraph)
+// Lines b|a|r of previousFile are the links a|b (cf RelationshipStream), CAIDA files writing providers first
+// Both are merged as streams: previousFile is never loaded in memory
+// Lines: "+a|b|r" (added), "-a|b|r" (removed), "~a|b|r|previous r" (changed), then a summary comment
+void printDiff( const Data& data, const string& previousFile, ostream& os )
+{
+    RelationshipStream previous( previousFile );
+    size_t added = 0, removed = 0, changed = 0, unchanged = 0;
+
+    os << "# diff against " << previousFile << '\n';
+
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        for ( ASData::const_iterator jt = it->second.begin(); jt != it->second.end(); ++jt )
+            if ( it->first < jt->first )
+            {
+                const pair< AS, AS > link( it->first, jt->first );
+                const int t = jt->second.relationship;
+
+                for ( ; previous.valid && previous.link < link; previous.next(), ++removed )
+                    os << '-' << previous.link.first << '|' << previous.link.second << '|' << previous.t << '\n';
+
+                if ( !previous.valid || link < previous.link )
+                {
+                    os << '+' << link.first << '|' << link.second << '|' << t << '\n';
+                    ++added;
+                    continue;
+                }
+
+                if ( previous.t != t )
+                {
+                    os << '~' << link.first << '|' << link.second << '|' << t << '|' << previous.t << '\n';
+                    ++changed;
+                }
+                else
+                    ++unchanged;
+
+                previous.next();
+            }
+
+    for ( ; previous.valid; previous.next(), ++removed )
+        os << '-' << previous.link.first << '|' << previous.link.second << '|' << previous.t << '\n';
+
+    os << "# " << added << " added, " << removed << " removed, " << changed << " changed, " << unchanged << " unchanged" << endl;
+}
+
+// Output customer cone sizes, one AS per line: "as size"
+// Sizes are estimated from sketches (cf cones.h) if data.options.approximateCones is set
+void printConeSizes( const Data& data, const string& file )
+{
+    ofstream fs( file.c_str() );
+
+    if ( data.options.approximateCones == 0 )
+    {
+        for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+            fs << it->first << ' ' << it->second.customerCone.size() << '\n';
+        return;
+    }
+
+    ConeSketches sketches( data, data.options.approximateCones );
+
+    fs << "# approximate sizes, relative standard error " << ConeSketches::relativeError( data.options.approximateCones ) << '\n';
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it )
+        fs << it->first << ' ' << static_cast< unsigned long >( sketches.size( it->first ) + 0.5 ) << '\n';
+}
+
+// Output the prefix cone of each AS, one AS per line: "as prefixes /24-equivalents" (cf PrefixCone in cones.h)
+// Cones are computed by data.options.threads threads
+void printPrefixCones( const Data& data, const string& file )
+{
+    vector< PrefixCone > cones;
+    computePrefixCones( data, cones, data.options.threads );
+
+    ofstream fs( file.c_str() );
+    fs << "# " << data.prefixes.size() << " origin prefixes; as prefixes /24-equivalents" << '\n';
+
+    size_t i = 0;
+    for ( Data::const_iterator it = data.begin(); it != data.end(); ++it, ++i )
+        fs << it->first << ' ' << cones[i].prefixes << ' ' << cones[i].addresses / 256.0 << '\n';
+}
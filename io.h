@@ -12,6 +12,8 @@
 #include <set>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <iostream>
 #include "data.h"
 
 /*
@@ -45,14 +47,29 @@
  * ////////////////
  *
  * One AS path per line, composed of AS numbered seperated by spaces.
+ * A line may start with the IPv4 prefix the path leads to:
+ *
+ * a.b.c.d/length|as1 as2 ... origin
+ *
+ * The prefix is then attached to the origin AS (cf Data::prefixes); other prefixes
+ * (IPv6) are ignored, as well as the prefixes of discarded paths.
  *
  */
 
 set< AS > loadASSet( const string& file );
 set< AS > loadASSet( const vector< string >& files );
 void loadRelationships( const vector< string >& relFiles, Data& data );
+bool readPath( istringstream& is, vector< AS >& asPath, const set< AS >& ixp, const set< AS >& clique );
+bool readPath( const AS* path, size_t length, vector< AS >& asPath, const set< AS >& ixp, const set< AS >& clique );
+bool readPrefix( const char*& begin, const char* end, uint32_t& network, unsigned char& length );
+bool tokenizePath( const char* it, const char* end, vector< AS >& asPath, AS& last, const set< AS >& ixp );
+bool acceptPath( vector< AS >& asPath, AS last, const set< AS >& clique );
+void addPath( const vector< AS >& asPath, Data& data );
 void loadPaths( const vector< string >& pathFiles, Data& data, const set< AS > ixp , const set< AS >& clique );
 void printGraph( const Data& data, const set< AS >& clique );
+void printDiff( const Data& data, const string& previousFile, ostream& os = cout );
+void printConeSizes( const Data& data, const string& file );
+void printPrefixCones( const Data& data, const string& file );
 
 #endif
 
@@ -10,14 +10,25 @@
 #include <set>
 #include <vector>
 #include <string>
-#include "data.h"
+#include <cstdlib>
+#include <thread>
+#include <stdexcept>
+#include <memory>
+#include "asrank.h"
 #include "io.h"
-#include "inference.h"
+#include "bench.h"
+#include "server.h"
+#include "sample.h"
+#include "accounting.h"
+#include "evidence.h"
 
 using namespace std;
 
 /*
- * asrank [--ixp ixpFile] [--rel relationshipFile] [--clique cliqueFile] file1 [file2 ...]
+ * asrank [--ixp ixpFile] [--rel relationshipFile] [--clique cliqueFile] [--spill-buffer megabytes] [--threads n] [--no-arena] [--bench] [--serve socket [--serve-reload relationshipFile]]
+ *        [--cone-sizes file] [--approx-cones k] [--sample percent[:full] [--sample-compare]] [--diff-against previousFile]
+ *        [--mem-report top] [--prefix-cones file] [--evidence snapshot] file1 [file2 ...]
+ * asrank explain a b snapshot
  *
  * --ixp ixpFile
  *   ixpFile contains a list of AS numbers corresponding to Internet Exchange Points.
@@ -36,15 +47,128 @@ using namespace std;
  *   Two AS numbers can be separated by a blank or newline character.
  *   Only one file may be given (in case multiple files are given, the last one is used).
  *   The '#' character comments the rest of the line it is on.
+ *
+ * --spill-buffer megabytes
+ *   Aggregates paths by spilling: triplets are sorted in buffers of about this size,
+ *   spilled to temporary files ($TMPDIR or /tmp) and merged into the final data, one update
+ *   per distinct triplet. Faster loading, but not a memory bound: the final data still holds
+ *   all triplets, so the peak is the same. The output is identical to the in-memory aggregation.
+ *
+ * --threads n
+ *   Loads path files with a pipeline of n threads (reading, parsing and aggregation stages),
+ *   ignored with --spill-buffer. Also runs the inference steps that do not depend on the order
+ *   of links (stub links and P2P completion), and the initialization of the data (transit
+ *   degrees, ranking and cone seeding), on n threads. The output does not depend on the
+ *   number of threads.
+ *
+ * --no-arena
+ *   Data containers allocate each node on the heap instead of from a monotonic arena.
+ *
+ * --bench
+ *   Reports on the standard error the duration of each step, the resident memory
+ *   and the number of allocations (heap calls and arena allocations). Loading is split
+ *   into path loading (and clique computation) and Data initialization.
+ *
+ * --serve socket
+ *   Instead of printing the relationships, keeps an index of the inferred graph and answers
+ *   queries on a Unix domain socket (protocol in server.h), with --threads threads (default:
+ *   one per core, at least 2). asrank-client is a load-test client for this mode.
+ *
+ * --serve-reload relationshipFile
+ *   CAIDA file that replaces the index when a client sends "reload" (the only file
+ *   clients can make the daemon read).
+ *
+ * --cone-sizes file
+ *   Writes the size of the customer cone of each AS in file ("as size" lines).
+ *
+ * --approx-cones k
+ *   Customer and provider cones are not kept during inference; sizes are estimated from bottom-k
+ *   sketches updated as links are set (relative standard error at most 1/sqrt(k-2), cf cones.h).
+ *   Relationships are the same as with exact cones.
+ *
+ * --prefix-cones file
+ *   Writes for each AS the number of distinct prefixes originated in its customer cone and
+ *   the address space they cover, in /24-equivalents, counting overlapping prefixes once
+ *   ("as prefixes slash24s" lines). Prefixes are read from prefix|path lines (cf io.h).
+ *   Cones are processed by --threads threads.
+ *
+ * --sample percent[:full]
+ *   Only loads the paths of percent % of the partial VPs and of full % of the full VPs
+ *   (default: all of them), for fast approximate runs (cf sample.h). VPs are classified
+ *   by a scan of the first and last AS of each path.
+ *
+ * --sample-compare
+ *   With --sample, also runs the full inference, then reports on the standard error the
+ *   speedup of the sampled run and, for each relationship type, the links it also found
+ *   and the rate of agreement. The relationships printed are those of the sampled run.
+ *
+ * --diff-against previousFile
+ *   Instead of all the relationships, outputs the links added, removed or changed since
+ *   previousFile (CAIDA format, sorted as asrank outputs it), and a summary line. A line b|a|r
+ *   with b > a (provider first) is read as a|b|-r, and links must be sorted once oriented so:
+ *     +a|b|r            added
+ *     -a|b|r            removed
+ *     ~a|b|r|previousR  changed
+ *   previousFile is read as a stream, without loading it in memory.
+ *
+ * --mem-report top
+ *   Reports on the standard error, after loading and after each inference step, the number
+ *   of nodes and bytes of each kind of structure of the data (cf accounting.h). They are read
+ *   from counters maintained by the allocators, at no cost, when top is 0; otherwise the data
+ *   is also traversed to list the top ASs with the heaviest structures of each kind.
+ *
+ * --evidence snapshot
+ *   Records the stage and the triggering triplet of every relationship set, then writes them
+ *   to snapshot with the offsets of a few paths of each link (cf evidence.h). Recording costs
+ *   20 bytes per link; the inference steps then run on a single thread.
+ *
+ * explain a b snapshot
+ *   Prints how the relationship of a and b was inferred, from an evidence snapshot: the stage
+ *   that set it, the triplet that triggered it, and the first paths the link was seen in
+ *   (the path files are read at the recorded offsets if they still exist).
  *           
  * file1 file2 ...
  *   These files contain AS paths.
- *   The format is one AS path per line, with each AS separated by a space (no prefix).
+ *   The format is one AS path per line, with each AS separated by a space, optionally
+ *   preceded by the IPv4 prefix it leads to: "a.b.c.d/length|as1 as2 ... origin" (cf io.h).
  *   At least one file must be provided.
  *   The '#' character comments the rest of the line it is on.
  *
  */
 
+// Helper function
+// Reports the memory used by data (--bench)
+void reportMemory( const Data& data )
+{
+    cerr << "bench : " << residentMemory() << " kB resident, " << data.heap.calls() << " heap allocations (" << ( data.heap.bytes() >> 10 ) << " kB)";
+    if ( data.arena )
+        cerr << ", " << data.arena->calls() << " arena allocations";
+    cerr << endl;
+}
+
+// Helper functor
+// Reports the duration of the phases of loading (--bench)
+struct LoadingReporter
+{
+    mutable Timer timer;
+
+    void operator()( const string& stage, const Data& data ) const
+    {
+        cerr << "bench : " << stage << ' ' << timer.seconds() << " s (" << data.size() << " AS)" << endl;
+        timer.reset();
+    }
+};
+
+// Helper functor
+// Reports memory after each inference step (--mem-report)
+struct MemoryReporter
+{
+    MemoryReporter( unsigned int t ) : top( t ) {}
+    unsigned int top;
+
+    void operator()( const string& stage, const Data& data ) const { printMemoryReport( data, stage, top, cerr ); }
+};
+
 int main( int argc, char** argv )
 {
     ios_base::sync_with_stdio( false ); // Theoretically speeds up I/O operations but requires never using stdin/stdout/stderr
@@ -53,8 +177,24 @@ int main( int argc, char** argv )
     // Parse argv //
     ////////////////
 
-    string cliqueFile;
+    if ( argc == 5 && string( argv[1] ) == "explain" )
+    {
+        try
+        {
+            return explainRelationship( argv[4], strtoul( argv[2], 0, 10 ), strtoul( argv[3], 0, 10 ), cout ) ? 0 : 1;
+        }
+        catch ( const exception& e )
+        {
+            cerr << "asrank : " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    string cliqueFile, socketPath, reloadFile, coneFile, previousFile, prefixConeFile, evidenceFile;
     vector< string > dataFiles, ixpFiles, relFiles;
+    Options options;
+    bool bench = false, compare = false, memReport = false;
+    unsigned int memTop = 0;
 
     int i;
     for ( i = 1; i < argc; i++ )
@@ -66,13 +206,53 @@ int main( int argc, char** argv )
             cliqueFile = argv[++i];
         else if ( arg == "--rel" )
             relFiles.push_back( argv[++i] );
+        else if ( arg == "--spill-buffer" )
+            options.spillBuffer = strtoul( argv[++i], 0, 10 ) << 20;
+        else if ( arg == "--threads" )
+            options.threads = strtoul( argv[++i], 0, 10 );
+        else if ( arg == "--no-arena" )
+            options.useArena = false;
+        else if ( arg == "--bench" )
+            bench = true;
+        else if ( arg == "--serve" )
+            socketPath = argv[++i];
+        else if ( arg == "--serve-reload" )
+            reloadFile = argv[++i];
+        else if ( arg == "--cone-sizes" )
+            coneFile = argv[++i];
+        else if ( arg == "--prefix-cones" )
+            prefixConeFile = argv[++i];
+        else if ( arg == "--approx-cones" )
+            options.approximateCones = strtoul( argv[++i], 0, 10 );
+        else if ( arg == "--sample" )
+        {
+            char* full;
+            options.samplePercent = strtoul( argv[++i], &full, 10 );
+            if ( *full == ':' )
+                options.sampleFullPercent = strtoul( full + 1, 0, 10 );
+        }
+        else if ( arg == "--sample-compare" )
+            compare = true;
+        else if ( arg == "--diff-against" )
+            previousFile = argv[++i];
+        else if ( arg == "--evidence" )
+        {
+            options.recordEvidence = true;
+            evidenceFile = argv[++i];
+        }
+        else if ( arg == "--mem-report" )
+        {
+            memReport = true;
+            memTop = strtoul( argv[++i], 0, 10 );
+        }
         else
             dataFiles.push_back( arg );
     }
 
     if ( dataFiles.empty() )
     {
-        cerr << "Usage : asrank [--ixp ixpFile] [--rel relationshipFile] [--clique cliqueFile] file1 [file 2 ...]." << endl;
+        cerr << "Usage : asrank [--ixp ixpFile] [--rel relationshipFile] [--clique cliqueFile] [--spill-buffer megabytes] [--threads n] [--no-arena] [--bench] [--serve socket [--serve-reload relationshipFile]] [--cone-sizes file] [--approx-cones k] [--sample percent[:full] [--sample-compare]] [--diff-against previousFile] [--mem-report top] [--prefix-cones file] [--evidence snapshot] file1 [file 2 ...]." << endl
+             << "        asrank explain a b snapshot" << endl;
         return 1;
     }
 
@@ -83,38 +263,153 @@ int main( int argc, char** argv )
     cerr << endl << "relationships :";
     for ( unsigned int i = 0; i < relFiles.size(); ++i )
         cerr << " " << relFiles[i];
+    if ( options.spillBuffer != 0 )
+        cerr << endl << "spill buffer : " << ( options.spillBuffer >> 20 ) << " MB";
+    if ( options.threads > 1 )
+        cerr << endl << "threads : " << options.threads;
+    const bool sampling = options.samplePercent < 100 || options.sampleFullPercent < 100;
+    if ( sampling )
+        cerr << endl << "sample : " << options.samplePercent << "% of partial VPs, " << options.sampleFullPercent << "% of full VPs";
     cerr << endl << "data :";
     for ( unsigned int i = 0; i < dataFiles.size(); ++i )
         cerr << " " << dataFiles[i];
     cerr << endl;
 
-    //////////////////////////////////
-    // Parse files and infer clique //
-    //////////////////////////////////
+    try
+    {
+        const set< AS > ixp = loadASSet( ixpFiles );
+        unique_ptr< ASRank > engine( new ASRank( options ) );
+
+        for ( unsigned int i = 0; i < dataFiles.size(); ++i )
+            engine->addPathFile( dataFiles[i] );
+        for ( unsigned int i = 0; i < relFiles.size(); ++i )
+            engine->addRelationshipFile( relFiles[i] );
+        if ( !ixp.empty() )
+            engine->addIXPs( ixp );
+        if ( !cliqueFile.empty() )
+            engine->setClique( loadASSet( cliqueFile ) );
+
+        //////////////////////////////////
+        // Parse files and infer clique //
+        //////////////////////////////////
+
+        Timer timer, total;
+
+        if ( bench )
+            engine->load( LoadingReporter() );
+        else
+            engine->load();
+
+        if ( sampling )
+        {
+            const VantagePointSample& sample = engine->sample();
+            cerr << "sample : " << sample.vantagePoints.size() - sample.fullChosen << " of " << sample.partial << " partial VPs, "
+                 << sample.fullChosen << " of " << sample.full << " full VPs" << endl;
+        }
+
+        if ( bench )
+        {
+            cerr << "bench : loading " << timer.seconds() << " s" << endl;
+            reportMemory( engine->data() );
+        }
+
+        if ( memReport )
+            printMemoryReport( engine->data(), "loading", memTop, cerr );
+
+        ///////////////
+        // Inference //
+        ///////////////
+
+        timer.reset();
+
+        if ( memReport )
+            engine->infer( MemoryReporter( memTop ) );
+        else
+            engine->infer();
+
+        if ( bench )
+        {
+            cerr << "bench : inference " << timer.seconds() << " s" << endl;
+            reportMemory( engine->data() );
+        }
+
+        if ( compare && sampling )
+        {
+            const double sampled = total.seconds();
+            Options fullOptions( options );
+            fullOptions.samplePercent = 100;
+            fullOptions.sampleFullPercent = 100;
 
-    set< AS > ixp = ixpFiles.empty() ? set< AS >() : loadASSet( ixpFiles );
-    set< AS > clique = cliqueFile.empty() ? computeClique( dataFiles, ixp ) : loadASSet( cliqueFile );
+            ASRank full( fullOptions );
+            for ( unsigned int i = 0; i < dataFiles.size(); ++i )
+                full.addPathFile( dataFiles[i] );
+            for ( unsigned int i = 0; i < relFiles.size(); ++i )
+                full.addRelationshipFile( relFiles[i] );
+            full.addIXPs( ixp );
+            if ( !cliqueFile.empty() )
+                full.setClique( engine->clique() );
 
-    Data data( dataFiles, relFiles, ixp, clique );
+            timer.reset();
+            full.run();
 
-    /////////////////////
-    // Begin Inference //
-    /////////////////////
+            cerr << "compare : speedup " << timer.seconds() / sampled << " (sampled " << sampled << " s, full " << timer.seconds() << " s)" << endl;
+            compareRelationships( full.data(), engine->data(), cerr );
+        }
 
-    addUpstreamProviderLinks( data );
-    findClientStubsSeenFromPartialVP( data );
-    addLinksToSmallerProviders( data );
-    breakTiesWhenNoProvider( data );
-    setCliqueStubLinksAsP2C( data, clique );
-    breakRemainingTies( data );
-    completeWithP2PLinks( data ); 
+        if ( !socketPath.empty() )
+        {
+            shared_ptr< const GraphIndex > index( new GraphIndex( engine->data() ) );
+            const unsigned int workers = options.threads > 1 ? options.threads : max( 2u, thread::hardware_concurrency() );
 
-    //////////////////////
-    // End of Inference //
-    //////////////////////
+            engine.reset(); // The index is all the daemon keeps
 
-    printGraph( data, clique );
+            cerr << "serving " << index->size() << " AS on " << socketPath << endl;
+            serve( socketPath, index, workers, reloadFile );
+        }
+
+        if ( previousFile.empty() )
+            printGraph( engine->data(), engine->clique() );
+        else
+            printDiff( engine->data(), previousFile );
+
+        if ( !coneFile.empty() )
+        {
+            timer.reset();
+            printConeSizes( engine->data(), coneFile );
+
+            if ( bench )
+                cerr << "bench : cone sizes " << timer.seconds() << " s, " << residentMemory() << " kB resident" << endl;
+        }
+
+        if ( !prefixConeFile.empty() )
+        {
+            timer.reset();
+            printPrefixCones( engine->data(), prefixConeFile );
+
+            if ( bench )
+                cerr << "bench : prefix cones " << timer.seconds() << " s, " << residentMemory() << " kB resident" << endl;
+        }
+
+        if ( !evidenceFile.empty() )
+        {
+            timer.reset();
+            writeEvidence( engine->data(), dataFiles, ixp, engine->clique(), evidenceFile );
+
+            if ( bench )
+                cerr << "bench : evidence " << engine->data().evidence.records().size() << " records, " << timer.seconds() << " s" << endl;
+        }
+
+        timer.reset();
+        engine.reset();
+
+        if ( bench )
+            cerr << "bench : teardown " << timer.seconds() << " s, " << peakResidentMemory() << " kB peak resident" << endl;
+    }
+    catch ( const exception& e )
+    {
+        cerr << "asrank : " << e.what() << endl;
+        return 1;
+    }
 
     return 0;
 }
-
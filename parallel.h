@@ -0,0 +1,102 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "arena.h"
+
+using namespace std;
+
+typedef unsigned int AS; // cf data.h
+
+/*
+ * Multi-threaded passes over Data (cf pipeline.h and inference.cpp)
+ *
+ * owner --> Partition of the ASs between n threads, by hash
+ *
+ *      A thread only updates Data[x] (links and sets of x) for the ASs x it owns, so
+ *      that no lock is needed. Updates of ASs owned by other threads are batched, then
+ *      applied by their owner in a next round.
+ *
+ * parallel --> Runs f( t ) for t = 0 .. n-1, each on its own thread, and waits for all of them
+ *
+ *      f( 0 ) runs on the calling thread. f( t ) allocates from lane t of the Data arena
+ *      (cf Arena::Lane), hence n should not exceed Arena::lanes.
+ *
+ * parallelSort --> Sorts a vector on n threads
+ *
+ *      Each thread sorts a chunk of the vector, then chunks are merged pairwise in log2( n )
+ *      rounds, the merges of a round running in parallel. Not stable: elements must be distinct
+ *      for the result to be the same as with sort.
+ */
+
+inline unsigned int owner( AS x, unsigned int n )
+{
+    return ( x * 2654435761u ) % n;
+}
+
+// Helper function
+// Runs f( t ) bound to lane t
+template< typename F >
+void runOnLane( const F& f, unsigned int t )
+{
+    Arena::Lane lane( t );
+    f( t );
+}
+
+template< typename F >
+void parallel( unsigned int n, const F& f )
+{
+    vector< thread > workers;
+
+    for ( unsigned int t = 1; t < n; ++t )
+        workers.push_back( thread( runOnLane< F >, cref( f ), t ) );
+
+    runOnLane( f, 0 );
+
+    for ( unsigned int t = 0; t < workers.size(); ++t )
+        workers[t].join();
+}
+
+// Helper functor
+// Rounds of parallelSort: chunk c of n is v[c*size/n..(c+1)*size/n-1]
+// Round 0 sorts chunk t, round w > 0 merges chunks 2tw..(2t+1)w-1 and (2t+1)w..(2t+2)w-1 (sorted in previous rounds)
+template< typename T >
+struct SortRound
+{
+    SortRound( vector< T >& values, unsigned int chunks, unsigned int w ) : v( values ), n( chunks ), width( w ) {}
+    vector< T >& v;
+    const unsigned int n;
+    const unsigned int width;
+
+    typename vector< T >::iterator bound( unsigned int c ) const { return v.begin() + v.size() * min( c, n ) / n; }
+
+    void operator()( unsigned int t ) const
+    {
+        if ( width == 0 )
+            sort( bound( t ), bound( t + 1 ) );
+        else
+            inplace_merge( bound( 2 * t * width ), bound( ( 2 * t + 1 ) * width ), bound( ( 2 * t + 2 ) * width ) );
+    }
+};
+
+template< typename T >
+void parallelSort( vector< T >& v, unsigned int n )
+{
+    n = max( 1u, n );
+    parallel( n, SortRound< T >( v, n, 0 ) );
+
+    for ( unsigned int width = 1; width < n; width *= 2 )
+        parallel( ( n + 2 * width - 1 ) / ( 2 * width ), SortRound< T >( v, n, width ) );
+}
+
+#endif
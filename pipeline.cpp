@@ -0,0 +1,240 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "pipeline.h"
+#include "queue.h"
+#include "parallel.h"
+#include "io.h"
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+const size_t blockSize = 1<<22; // Bytes read at once by the reader
+
+// Paths accepted by a parser, path i is ases[ends[i-1]..ends[i]-1]
+struct PathBatch
+{
+    vector< AS > ases;
+    vector< size_t > ends;
+};
+
+typedef unique_ptr< string > Block;
+typedef shared_ptr< const PathBatch > Batch;
+
+// Parser stage
+// Splits blocks into lines and emits the accepted paths of each block as one batch
+// Paths from ASs not in vantagePoints are dropped, unless it is empty
+// Prefixes of prefix|path lines are added to the prefixes of the parser
+void parse( BoundedQueue< Block >& blocks, vector< unique_ptr< BoundedQueue< Batch > > >& batches, const set< AS >& ixp, const set< AS >& clique, const set< AS >& vantagePoints,
+    PrefixTable& prefixes )
+{
+    vector< AS > asPath;
+
+    while ( Block block = blocks.pop() )
+    {
+        shared_ptr< PathBatch > batch( new PathBatch );
+        const char* it = block->data();
+        const char* const end = it + block->size();
+
+        while ( it != end )
+        {
+            const char* eol = it;
+            while ( eol != end && *eol != '\n' )
+                ++eol;
+
+            const char* const begin = it;
+            it = eol != end ? eol + 1 : eol;
+
+            if ( begin == eol || find( begin, eol, '#' ) != eol ) // Same lines as loadPaths
+                continue;
+
+            const char* path = begin;
+            uint32_t network;
+            unsigned char length;
+            const bool prefixed = readPrefix( path, eol, network, length );
+
+            AS last = 0;
+            bool accepted;
+
+            if ( tokenizePath( path, eol, asPath, last, ixp ) )
+                accepted = acceptPath( asPath, last, clique );
+            else
+            {
+                istringstream is( string( path, eol ) );
+                accepted = readPath( is, asPath, ixp, clique );
+            }
+
+            if ( accepted && ( vantagePoints.empty() || vantagePoints.count( asPath[0] ) != 0 ) )
+            {
+                if ( prefixed )
+                    prefixes.add( asPath.back(), network, length );
+
+                batch->ases.insert( batch->ases.end(), asPath.begin(), asPath.end() );
+                batch->ends.push_back( batch->ases.size() );
+            }
+        }
+
+        for ( unsigned int k = 0; k < batches.size(); ++k )
+            batches[k]->push( batch );
+    }
+
+    for ( unsigned int k = 0; k < batches.size(); ++k )
+        batches[k]->push( Batch() ); // End of stream
+}
+
+// Helper function
+// Part of addPath (cf io.h) that updates Data[x] for the ASs x owned by aggregator k
+// Transit pairs replace the upstream flag, owned by another aggregator, to detect new triplets
+void addOwnedPath( const AS* asPath, unsigned int size, pmr::map< AS, ASData >& data, unsigned int k, unsigned int n )
+{
+    if ( owner( asPath[0], n ) == k )
+    {
+        ASData& data0 = data[asPath[0]];
+        data0.visibilityAsVP.insert( asPath[size-1] );
+        data0[asPath[1]];
+    }
+
+    if ( owner( asPath[1], n ) == k )
+        data[asPath[1]][asPath[0]];
+
+    for ( unsigned int i = 1; i + 1 < size; ++i )
+    {
+        const AS x = asPath[i-1], y = asPath[i], z = asPath[i+1];
+        const bool last = ( i == size - 2 );
+
+        if ( owner( z, n ) == k )
+        {
+            TripletData& dZYX = data[z][y][x];
+            ++dZYX.count;
+            dZYX.upstream = true;
+            dZYX.endOfPath |= last;
+        }
+
+        if ( owner( x, n ) == k )
+        {
+            TripletData& dXYZ = data[x][y][z];
+            ++dXYZ.count;
+            dXYZ.twoEdgePath |= ( last && size == 3 );
+        }
+
+        if ( owner( y, n ) == k )
+        {
+            ASData& dY = data[y];
+            if ( dY.transitPairs.insert( make_pair( x, z ) ).second ) // Triplet not seen yet
+            {
+                dY[x].transit = true;
+                dY[z].transit = true;
+            }
+        }
+    }
+}
+
+// Aggregator stage
+// Applies every batch to the partial Data of aggregator k until all parsers are done
+// Aggregator k allocates from lane k+1 of the Data arena
+void aggregate( BoundedQueue< Batch >& batches, pmr::map< AS, ASData >& data, unsigned int k, unsigned int n, unsigned int parsers )
+{
+    Arena::Lane lane( k + 1 );
+
+    while ( parsers != 0 )
+    {
+        Batch batch = batches.pop();
+
+        if ( !batch )
+        {
+            --parsers;
+            continue;
+        }
+
+        size_t begin = 0;
+        for ( size_t i = 0; i < batch->ends.size(); ++i )
+        {
+            addOwnedPath( &batch->ases[begin], batch->ends[i] - begin, data, k, n );
+            begin = batch->ends[i];
+        }
+    }
+}
+
+// Reader stage (calling thread)
+// Blocks are cut after the last end of line they contain; files always end a line
+void read( const vector< string >& pathFiles, BoundedQueue< Block >& blocks )
+{
+    string carry;
+
+    for ( unsigned int i = 0; i < pathFiles.size(); ++i )
+    {
+        ifstream fs( pathFiles[i].c_str(), ios::binary );
+
+        while ( fs )
+        {
+            Block block( new string( carry ) );
+            block->resize( carry.size() + blockSize );
+            fs.read( &(*block)[carry.size()], blockSize );
+            block->resize( carry.size() + fs.gcount() );
+
+            const size_t eol = block->rfind( '\n' );
+            if ( !fs )
+                carry.clear();
+            else if ( eol == string::npos ) // Line longer than a block
+            {
+                carry.swap( *block );
+                continue;
+            }
+            else
+            {
+                carry.assign( *block, eol + 1, string::npos );
+                block->resize( eol + 1 );
+            }
+
+            if ( !block->empty() )
+                blocks.push( std::move( block ) );
+        }
+    }
+}
+
+void loadPathsPipelined( const vector< string >& pathFiles, Data& data, const set< AS >& ixp, const set< AS >& clique, unsigned int threads )
+{
+    const unsigned int parsers = max( 1u, threads / 2 );
+    const unsigned int aggregators = min( max( 1u, threads - parsers ), Arena::lanes - 1 );
+
+    BoundedQueue< Block > blocks( 2 * parsers );
+    vector< unique_ptr< BoundedQueue< Batch > > > batches;
+    vector< pmr::map< AS, ASData > > partitions;
+    vector< PrefixTable > prefixes( parsers );
+    vector< thread > workers;
+
+    partitions.reserve( aggregators );
+    for ( unsigned int k = 0; k < aggregators; ++k )
+    {
+        batches.emplace_back( new BoundedQueue< Batch >( 4 * parsers ) );
+        partitions.emplace_back( data.get_allocator() ); // Same resource as data, required by merge
+    }
+
+    for ( unsigned int k = 0; k < aggregators; ++k )
+        workers.push_back( thread( aggregate, ref( *batches[k] ), ref( partitions[k] ), k, aggregators, parsers ) );
+
+    for ( unsigned int p = 0; p < parsers; ++p )
+        workers.push_back( thread( parse, ref( blocks ), ref( batches ), cref( ixp ), cref( clique ), cref( data.vantagePoints ), ref( prefixes[p] ) ) );
+
+    read( pathFiles, blocks );
+
+    for ( unsigned int p = 0; p < parsers; ++p )
+        blocks.push( Block() ); // End of stream
+
+    for ( unsigned int i = 0; i < workers.size(); ++i )
+        workers[i].join();
+
+    for ( unsigned int k = 0; k < aggregators; ++k )
+        data.merge( partitions[k] ); // Partitions have disjoint keys, nodes are moved
+
+    for ( unsigned int p = 0; p < parsers; ++p )
+        data.prefixes.merge( prefixes[p] );
+}
+
@@ -0,0 +1,37 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <set>
+#include <vector>
+#include <string>
+#include "data.h"
+
+/*
+ * Multi-threaded loading of path files, as a pipeline of three stages:
+ *
+ *      reader (calling thread) --> blocks of complete lines
+ *      parsers                 --> batches of accepted paths, stored in a flat array
+ *      aggregators             --> partial Data restricted to the ASs they own
+ *
+ * Stages are connected by bounded lock-free queues (cf queue.h); a full queue
+ * puts the previous stage to sleep, an empty one the next stage. Each batch is handed to every aggregator, which only
+ * updates Data[x] for the ASs x it owns (ASs are partitioned by hash), so no lock
+ * is needed. The partial Data are spliced together at the end.
+ *
+ * threads is the number of parsers plus aggregators (at least 2, at most Arena::lanes - 1 aggregators).
+ * Data is identical to the one built by loadPaths with a single thread (including the
+ * vantage point filter, cf sample.h).
+ */
+
+void loadPathsPipelined( const vector< string >& pathFiles, Data& data, const set< AS >& ixp, const set< AS >& clique, unsigned int threads );
+
+#endif
+
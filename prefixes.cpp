@@ -0,0 +1,113 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "prefixes.h"
+#include <algorithm>
+
+const size_t firstCompaction = 1<<16; // Entries
+
+// Helper functions
+// Order and equality of entries (origin, network, length)
+inline bool operator<( const PrefixTable::Entry& a, const PrefixTable::Entry& b )
+{
+    if ( a.origin != b.origin )
+        return a.origin < b.origin;
+    if ( a.network != b.network )
+        return a.network < b.network;
+    return a.length < b.length;
+}
+
+inline bool operator==( const PrefixTable::Entry& a, const PrefixTable::Entry& b )
+{
+    return a.origin == b.origin && a.network == b.network && a.length == b.length;
+}
+
+// Helper function
+// Required for lower_bound and upper_bound in function prefixes
+inline bool originLess( const PrefixTable::Entry& e, AS origin ) { return e.origin < origin; }
+inline bool lessOrigin( AS origin, const PrefixTable::Entry& e ) { return origin < e.origin; }
+
+PrefixTable::PrefixTable() : sorted( 0 ), threshold( firstCompaction ) {}
+
+void PrefixTable::add( AS origin, uint32_t network, unsigned char length )
+{
+    const Entry e = { origin, network, length };
+    entries.push_back( e );
+
+    if ( entries.size() >= threshold )
+    {
+        compact();
+        threshold = max( 2 * entries.size(), firstCompaction );
+    }
+}
+
+void PrefixTable::merge( PrefixTable& other )
+{
+    entries.insert( entries.end(), other.entries.begin(), other.entries.end() );
+    other.clear();
+}
+
+// Sorts the entries added since the last compaction, then merges them with the others
+void PrefixTable::compact()
+{
+    sort( entries.begin() + sorted, entries.end() );
+    inplace_merge( entries.begin(), entries.begin() + sorted, entries.end() );
+    entries.erase( unique( entries.begin(), entries.end() ), entries.end() );
+    sorted = entries.size();
+}
+
+void PrefixTable::clear()
+{
+    vector< Entry >().swap( entries );
+    sorted = 0;
+    threshold = firstCompaction;
+}
+
+const PrefixTable::Entry* PrefixTable::prefixes( AS origin, const Entry*& end ) const
+{
+    const Entry* const first = entries.data();
+    const Entry* const last = first + sorted;
+
+    end = upper_bound( first, last, origin, lessOrigin );
+    return lower_bound( first, end, origin, originLess );
+}
+
+bool parsePrefix( const char* it, const char* end, uint32_t& network, unsigned char& length )
+{
+    uint32_t address = 0;
+
+    while ( it != end && ( *it == ' ' || *it == '\t' ) )
+        ++it;
+
+    for ( unsigned int i = 0; i < 4; ++i )
+    {
+        unsigned int byte = 0, digits = 0;
+        for ( ; it != end && *it >= '0' && *it <= '9' && digits < 4; ++digits )
+            byte = 10 * byte + ( *it++ - '0' );
+
+        if ( digits == 0 || byte > 255 || it == end || *it++ != ( i < 3 ? '.' : '/' ) )
+            return false;
+
+        address = ( address << 8 ) | byte;
+    }
+
+    unsigned int l = 0, digits = 0;
+    for ( ; it != end && *it >= '0' && *it <= '9' && digits < 3; ++digits )
+        l = 10 * l + ( *it++ - '0' );
+
+    while ( it != end && ( *it == ' ' || *it == '\t' ) )
+        ++it;
+
+    if ( digits == 0 || l > 32 || it != end )
+        return false;
+
+    length = l;
+    network = l == 0 ? 0 : address & ( 0xFFFFFFFFu << ( 32 - l ) );
+    return true;
+}
+
@@ -0,0 +1,59 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef PREFIXES_H
+#define PREFIXES_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+typedef unsigned int AS; // cf data.h
+
+/*
+ * PrefixTable --> IPv4 prefixes originated by each AS (prefix|path input format, cf io.h)
+ *
+ *      Entries (origin, network, length) are stored in a flat vector, 12 bytes each.
+ *      It is sorted and deduplicated whenever it doubles, so that a prefix seen in many
+ *      paths is only stored once per origin. After compact(), entries are sorted by
+ *      origin then network: the prefixes of an AS are a range of the table (cf prefixes).
+ */
+
+class PrefixTable
+{
+public:
+    struct Entry
+    {
+        AS origin;
+        uint32_t network; // Masked with length
+        unsigned char length;
+    };
+
+    PrefixTable();
+
+    void add( AS origin, uint32_t network, unsigned char length );
+    void merge( PrefixTable& other ); // Empties other
+    void compact(); // Required before prefixes()
+    void clear();
+
+    size_t size() const { return entries.size(); }
+    const Entry* prefixes( AS origin, const Entry*& end ) const; // [begin, end), sorted by network then length
+
+private:
+    vector< Entry > entries;
+    size_t sorted; // entries[0..sorted-1] are sorted and distinct
+    size_t threshold; // Next automatic compaction
+};
+
+// Parses "a.b.c.d/length" in [begin, end); returns false if it is not an IPv4 prefix
+bool parsePrefix( const char* begin, const char* end, uint32_t& network, unsigned char& length );
+
+#endif
+
@@ -0,0 +1,167 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+/*
+ * BoundedQueue --> Lock-free multi-producer multi-consumer queue of fixed capacity
+ *
+ *      Each cell carries a sequence number telling producers and consumers whether
+ *      it is free or filled for their turn (D. Vyukov's bounded queue).
+ *      push waits while the queue is full (backpressure), pop waits while it is empty.
+ *      push and pop only take a lock to sleep, and to wake up sleeping threads when
+ *      there are some: an idle stage blocks on a condition variable instead of spinning.
+ *
+ *      capacity is rounded up to a power of 2
+ */
+
+template< typename T >
+class BoundedQueue
+{
+public:
+    BoundedQueue( size_t capacity ) : cells( roundUp( capacity ) ), mask( cells.size() - 1 ), head( 0 ), tail( 0 )
+    {
+        for ( size_t i = 0; i < cells.size(); ++i )
+            cells[i].sequence.store( i, memory_order_relaxed );
+    }
+
+    bool tryPush( T& value )
+    {
+        size_t position = tail.load( memory_order_relaxed );
+
+        while ( true )
+        {
+            Cell& cell = cells[position & mask];
+            const size_t sequence = cell.sequence.load( memory_order_acquire );
+            const ptrdiff_t diff = static_cast< ptrdiff_t >( sequence ) - static_cast< ptrdiff_t >( position );
+
+            if ( diff == 0 )
+            {
+                if ( tail.compare_exchange_weak( position, position + 1, memory_order_relaxed ) )
+                {
+                    cell.value = std::move( value );
+                    cell.sequence.store( position + 1, memory_order_release );
+                    return true;
+                }
+            }
+            else if ( diff < 0 )
+                return false; // Full
+            else
+                position = tail.load( memory_order_relaxed );
+        }
+    }
+
+    bool tryPop( T& value )
+    {
+        size_t position = head.load( memory_order_relaxed );
+
+        while ( true )
+        {
+            Cell& cell = cells[position & mask];
+            const size_t sequence = cell.sequence.load( memory_order_acquire );
+            const ptrdiff_t diff = static_cast< ptrdiff_t >( sequence ) - static_cast< ptrdiff_t >( position + 1 );
+
+            if ( diff == 0 )
+            {
+                if ( head.compare_exchange_weak( position, position + 1, memory_order_relaxed ) )
+                {
+                    value = std::move( cell.value );
+                    cell.sequence.store( position + mask + 1, memory_order_release );
+                    return true;
+                }
+            }
+            else if ( diff < 0 )
+                return false; // Empty
+            else
+                position = head.load( memory_order_relaxed );
+        }
+    }
+
+    void push( T value )
+    {
+        if ( !tryPush( value ) )
+            notFull.wait( [&]() { return tryPush( value ); } );
+        notEmpty.notify();
+    }
+
+    T pop()
+    {
+        T value;
+        if ( !tryPop( value ) )
+            notEmpty.wait( [&]() { return tryPop( value ); } );
+        notFull.notify();
+        return value;
+    }
+
+private:
+    struct Cell
+    {
+        atomic< size_t > sequence;
+        T value;
+    };
+
+    // Helper structure: threads sleeping until a condition holds
+    // waiting is raised before the condition is tried again and read after the other side
+    // changed the queue (both behind a full fence), so either the sleeper sees the change
+    // or the notifier sees the sleeper; the lock then prevents a lost wake-up
+    struct Sleepers
+    {
+        Sleepers() : waiting( 0 ) {}
+
+        template< typename Condition >
+        void wait( Condition condition )
+        {
+            unique_lock< mutex > lock( guard );
+            waiting.fetch_add( 1 );
+            atomic_thread_fence( memory_order_seq_cst );
+            while ( !condition() )
+                awake.wait( lock );
+            waiting.fetch_sub( 1 );
+        }
+
+        void notify()
+        {
+            atomic_thread_fence( memory_order_seq_cst );
+            if ( waiting.load() == 0 )
+                return;
+            lock_guard< mutex > lock( guard );
+            awake.notify_all();
+        }
+
+        mutex guard;
+        condition_variable awake;
+        atomic< unsigned int > waiting;
+    };
+
+    static size_t roundUp( size_t n )
+    {
+        size_t p = 2;
+        while ( p < n )
+            p <<= 1;
+        return p;
+    }
+
+    vector< Cell > cells;
+    const size_t mask;
+    alignas( 64 ) atomic< size_t > head;
+    alignas( 64 ) atomic< size_t > tail;
+    Sleepers notFull;
+    Sleepers notEmpty;
+};
+
+#endif
+
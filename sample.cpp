@@ -0,0 +1,195 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "sample.h"
+#include "io.h"
+#include "cones.h"
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+
+void DistinctCount::add( AS x )
+{
+    const uint64_t h = hash64( x );
+    if ( smallest.size() == sampleSketch && h >= smallest.back() )
+        return;
+
+    vector< uint64_t >::iterator it = lower_bound( smallest.begin(), smallest.end(), h );
+    if ( it != smallest.end() && *it == h )
+        return;
+
+    if ( smallest.size() == sampleSketch )
+        smallest.pop_back();
+    smallest.insert( it, h );
+}
+
+double DistinctCount::size() const
+{
+    if ( smallest.size() < sampleSketch )
+        return smallest.size(); // Exact
+
+    return ( sampleSketch - 1 ) / ( ( smallest.back() + 1.0 ) / 18446744073709551616.0 );
+}
+
+// Helper function
+// Reads the AS number ending at end (false if there is none)
+inline bool lastAS( const char* begin, const char*& end, AS& as )
+{
+    while ( end != begin && isspace( static_cast< unsigned char >( end[-1] ) ) )
+        --end;
+
+    const char* digits = end;
+    while ( digits != begin && isdigit( static_cast< unsigned char >( digits[-1] ) ) )
+        --digits;
+
+    if ( digits == end || end - digits > 10 )
+        return false;
+
+    as = strtoul( digits, 0, 10 );
+    end = digits;
+    return true;
+}
+
+// Helper function
+// Reads the first AS number from begin that is not an IXP (false if there is none)
+inline bool firstAS( const char*& begin, const char* end, const set< AS >& ixp, AS& as )
+{
+    while ( true )
+    {
+        while ( begin != end && isspace( static_cast< unsigned char >( *begin ) ) )
+            ++begin;
+
+        const char* digits = begin;
+        while ( begin != end && isdigit( static_cast< unsigned char >( *begin ) ) )
+            ++begin;
+
+        if ( digits == begin || begin - digits > 10 )
+            return false;
+
+        as = strtoul( digits, 0, 10 );
+        if ( ixp.count( as ) == 0 )
+            return true;
+    }
+}
+
+// Scans the same lines as loadPaths, reading only the first and last AS of each path
+void VantagePointSampler::addFile( const string& file )
+{
+    ifstream fs( file.c_str() );
+    string line;
+
+    while ( getline( fs, line ) )
+    {
+        if ( line.empty() || line.find( '#' ) != string::npos )
+            continue;
+
+        const char* path = line.data();
+        const char* end = line.data() + line.size();
+        uint32_t network;
+        unsigned char length;
+        readPrefix( path, end, network, length );
+
+        AS first, last;
+        if ( lastAS( path, end, last ) && firstAS( path, end, ixp, first ) )
+            add( first, last );
+    }
+}
+
+void VantagePointSampler::addPath( const AS* path, size_t length )
+{
+    size_t i = 0;
+    while ( i + 1 < length && ixp.count( path[i] ) != 0 )
+        ++i;
+
+    if ( i + 1 < length )
+        add( path[i], path[length-1] );
+}
+
+// Helper function
+// Records a path of at least two ASs (the first one not an IXP)
+void VantagePointSampler::add( AS first, AS last )
+{
+    visibility[first].add( last );
+    ases.add( first );
+    ases.add( last );
+}
+
+// Same classification as findClientStubsSeenFromPartialVP (cf inference.h)
+VantagePointSample VantagePointSampler::select( const Options& options ) const
+{
+    VantagePointSample sample;
+    const double n = ases.size();
+
+    for ( map< AS, DistinctCount >::const_iterator it = visibility.begin(); it != visibility.end(); ++it )
+    {
+        const bool full = it->second.size() * options.partialVPRatio >= n;
+        const unsigned int percent = full ? options.sampleFullPercent : options.samplePercent;
+
+        ++( full ? sample.full : sample.partial );
+
+        if ( hash64( it->first ) % 10000 < percent * 100ull )
+        {
+            sample.vantagePoints.insert( it->first );
+            sample.fullChosen += full;
+        }
+    }
+
+    return sample;
+}
+
+// Helper function
+// Relationship of a with b in data, UNKNOWN if they are not linked
+inline TypeOfRelationship relationship( const Data& data, AS a, AS b )
+{
+    Data::const_iterator it = data.find( a );
+    if ( it == data.end() )
+        return UNKNOWN;
+
+    ASData::const_iterator jt = it->second.find( b );
+    return jt != it->second.end() ? jt->second.relationship : UNKNOWN;
+}
+
+void compareRelationships( const Data& full, const Data& sampled, ostream& os )
+{
+    const char* const names[] = { "P2C", "P2P", "S2S", "UNKNOWN" };
+    size_t links[4] = { 0, 0, 0, 0 }, found[4] = { 0, 0, 0, 0 }, agree[4] = { 0, 0, 0, 0 };
+
+    for ( Data::const_iterator it = full.begin(); it != full.end(); ++it )
+        for ( ASData::const_iterator jt = it->second.begin(); jt != it->second.end(); ++jt )
+            if ( it->first < jt->first )
+            {
+                const TypeOfRelationship t = jt->second.relationship;
+                const unsigned int type = ( t == P2C || t == C2P ) ? 0 : ( t == P2P ) ? 1 : ( t == S2S ) ? 2 : 3;
+
+                ++links[type];
+
+                Data::const_iterator s = sampled.find( it->first );
+                if ( s == sampled.end() || s->second.count( jt->first ) == 0 )
+                    continue;
+
+                ++found[type];
+                if ( relationship( sampled, it->first, jt->first ) == t )
+                    ++agree[type];
+            }
+
+    for ( unsigned int type = 0; type < 4; ++type )
+    {
+        if ( links[type] == 0 )
+            continue;
+
+        os << "compare : " << names[type] << ' ' << links[type] << " links, " << found[type] << " in sample ("
+           << 100.0 * found[type] / links[type] << "%), " << agree[type] << " agree (";
+        if ( found[type] != 0 )
+            os << 100.0 * agree[type] / found[type] << "% of those in sample)" << endl;
+        else
+            os << "-)" << endl;
+    }
+}
+
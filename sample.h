@@ -0,0 +1,83 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+#include <ostream>
+#include "data.h"
+
+/*
+ * Vantage point sampling --> Fast approximate inference on a subset of the paths
+ *
+ *      A first pass over the paths estimates the visibility of each VP (first AS of a path,
+ *      cf ASData::visibilityAsVP) and classifies it as full or partial, as the inference
+ *      does (cf Options::partialVPRatio). Each class is sampled separately: samplePercent %
+ *      of the partial VPs are kept, and sampleFullPercent % of the full ones (all of them by
+ *      default). VPs are chosen by a hash of their AS number: the choice is deterministic,
+ *      and a sample contains the samples of lower percentages.
+ *      Paths are then only loaded from the chosen VPs (cf Data::vantagePoints).
+ *
+ *      The first pass is a scan of the ends of each line, much cheaper than loading: only the
+ *      first and last ASs are parsed (IXPs skipped at the start), and paths are not checked
+ *      (cf acceptPath). Distinct counts are estimated with the k smallest hashes, as cone
+ *      sketches (cf cones.h, k = sampleSketch): the last ASs of the paths of each VP for its
+ *      visibility, and the first and last ASs of all paths for the number of ASs (nearly all
+ *      ASs originate prefixes). VPs near the partial/full threshold may be misclassified.
+ */
+
+const unsigned int sampleSketch = 1024; // Relative standard error about 3%
+
+// Helper structure
+// Estimated number of distinct ASs added
+struct DistinctCount
+{
+    void add( AS x );
+    double size() const;
+
+    vector< uint64_t > smallest; // sampleSketch smallest hashes, sorted
+};
+
+struct VantagePointSample
+{
+    VantagePointSample() : full( 0 ), partial( 0 ), fullChosen( 0 ) {}
+
+    set< AS > vantagePoints; // Chosen VPs
+    unsigned int full; // Before sampling
+    unsigned int partial;
+    unsigned int fullChosen;
+};
+
+class VantagePointSampler
+{
+public:
+    VantagePointSampler( const set< AS >& ixp ) : ixp( ixp ) {}
+
+    void addFile( const string& file ); // Format detailed in io.h
+    void addPath( const AS* path, size_t length );
+
+    VantagePointSample select( const Options& options ) const;
+
+private:
+    void add( AS first, AS last );
+
+    const set< AS >& ixp;
+    map< AS, DistinctCount > visibility;
+    DistinctCount ases;
+};
+
+// Compares the relationships inferred from a sample with those of the full inference
+// Reports, for each relationship type of the full inference, the links also inferred from the sample and the agreeing ones
+void compareRelationships( const Data& full, const Data& sampled, ostream& os );
+
+#endif
+
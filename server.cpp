@@ -0,0 +1,267 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#include "server.h"
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+
+const size_t readSize = 1<<16;
+const size_t maxLineLength = 1<<10; // Queries are a few words long
+
+// Helper function
+// Answers one query line (without its end of line) and appends the answer to out
+// index may be replaced by a reload of reloadFile
+void answer( const string& line, shared_ptr< const GraphIndex >& index, shared_ptr< const GraphIndex >* snapshot, const string& reloadFile, string& out )
+{
+    istringstream is( line );
+    string command, extra;
+    is >> command;
+
+    ostringstream os;
+    AS a, b;
+
+    if ( command == "rel" && is >> a >> b )
+    {
+        TypeOfRelationship t;
+        os << a << '|' << b << '|';
+        if ( index->relationship( a, b, t ) )
+            os << static_cast< int >( t );
+        else
+            os << "none";
+    }
+    else if ( command == "cone" && is >> a >> b )
+        os << ( index->inCustomerCone( b, a ) ? 1 : 0 );
+    else if ( command == "size" && is >> a )
+        os << index->customerConeSize( a );
+    else if ( command == "reload" && !( is >> extra ) )
+    {
+        try
+        {
+            if ( reloadFile.empty() )
+                throw runtime_error( "no snapshot file" );
+
+            shared_ptr< const GraphIndex > fresh( new GraphIndex( reloadFile ) );
+            atomic_store( snapshot, fresh );
+            index = fresh;
+            os << "ok " << fresh->size();
+        }
+        catch ( const exception& e )
+        {
+            os << "error " << e.what();
+        }
+    }
+    else
+        os << "error";
+
+    out += os.str();
+    out += '\n';
+}
+
+// Helper function
+// Writes the whole buffer (false if the client is gone)
+bool writeAll( int fd, const string& buffer )
+{
+    size_t done = 0;
+    while ( done < buffer.size() )
+    {
+        const ssize_t n = write( fd, buffer.data() + done, buffer.size() - done );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+// Helper structure
+// Client connection, with the end of its last read that is not a complete line
+struct Connection
+{
+    int fd;
+    string pending;
+};
+
+// Helper structure
+// Connections handed between the dispatcher (cf serve) and the workers
+struct Dispatch
+{
+    Dispatch( shared_ptr< const GraphIndex > index, const string& file ) : snapshot( index ), reloadFile( file ) {}
+
+    shared_ptr< const GraphIndex > snapshot;
+    const string reloadFile;
+
+    mutex lock;
+    condition_variable ready;
+    deque< Connection > readable; // Polled as readable, for the workers
+    vector< Connection > served; // Back from the workers, to be polled again
+    int wakeup[2]; // Pipe written by a worker when it hands a connection back
+};
+
+// Helper function
+// Answers one read of a readable connection, against the snapshot current at its start
+// Returns false if the client is gone, or sent a line longer than maxLineLength
+bool answerBatch( Connection& c, Dispatch& dispatch )
+{
+    char buffer[readSize];
+    ssize_t n;
+
+    while ( ( n = read( c.fd, buffer, readSize ) ) < 0 && errno == EINTR )
+        ;
+    if ( n <= 0 )
+        return false;
+
+    c.pending.append( buffer, n );
+
+    shared_ptr< const GraphIndex > index = atomic_load( &dispatch.snapshot );
+    size_t begin = 0, eol;
+    string out;
+
+    while ( ( eol = c.pending.find( '\n', begin ) ) != string::npos )
+    {
+        answer( c.pending.substr( begin, eol - begin ), index, &dispatch.snapshot, dispatch.reloadFile, out );
+        begin = eol + 1;
+    }
+
+    c.pending.erase( 0, begin );
+
+    if ( c.pending.size() > maxLineLength ) // The connection is closed, rather than buffering without bound
+    {
+        out += "error line too long\n";
+        writeAll( c.fd, out );
+        return false;
+    }
+
+    return writeAll( c.fd, out );
+}
+
+// Worker of the pool: answers one read of a readable connection at a time, then hands it back to the dispatcher
+void work( Dispatch* dispatch )
+{
+    while ( true )
+    {
+        Connection c;
+        {
+            unique_lock< mutex > l( dispatch->lock );
+            dispatch->ready.wait( l, [dispatch] { return !dispatch->readable.empty(); } );
+            c = move( dispatch->readable.front() );
+            dispatch->readable.pop_front();
+        }
+
+        if ( !answerBatch( c, *dispatch ) )
+        {
+            close( c.fd );
+            continue;
+        }
+
+        {
+            lock_guard< mutex > l( dispatch->lock );
+            dispatch->served.push_back( move( c ) );
+        }
+
+        const char byte = 0;
+        while ( write( dispatch->wakeup[1], &byte, 1 ) < 0 && errno == EINTR )
+            ;
+    }
+}
+
+void serve( const string& socketPath, shared_ptr< const GraphIndex > index, unsigned int threads, const string& reloadFile )
+{
+    sockaddr_un address;
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+
+    if ( socketPath.size() >= sizeof( address.sun_path ) )
+        throw runtime_error( "socket path too long: " + socketPath );
+    strcpy( address.sun_path, socketPath.c_str() );
+
+    const int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+    unlink( socketPath.c_str() );
+
+    if ( listener < 0
+        || bind( listener, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0
+        || listen( listener, SOMAXCONN ) != 0 )
+        throw runtime_error( "cannot listen on " + socketPath + ": " + strerror( errno ) );
+
+    signal( SIGPIPE, SIG_IGN ); // Clients leaving are detected by write
+
+    // Never destroyed, since the workers never stop
+    Dispatch& dispatch = *new Dispatch( index, reloadFile );
+    if ( pipe( dispatch.wakeup ) != 0 )
+        throw runtime_error( string( "cannot create pipe: " ) + strerror( errno ) );
+
+    for ( unsigned int i = 0; i < threads; ++i )
+        thread( work, &dispatch ).detach();
+
+    // Idle connections are polled here; a readable one goes to the workers until they hand it back
+    vector< Connection > idle;
+    vector< pollfd > fds;
+
+    while ( true )
+    {
+        fds.resize( 2 + idle.size() );
+        fds[0].fd = listener;
+        fds[1].fd = dispatch.wakeup[0];
+        for ( size_t i = 0; i < idle.size(); ++i )
+            fds[2+i].fd = idle[i].fd;
+        for ( size_t i = 0; i < fds.size(); ++i )
+            fds[i].events = POLLIN;
+
+        if ( poll( &fds[0], fds.size(), -1 ) < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            throw runtime_error( string( "cannot poll connections: " ) + strerror( errno ) );
+        }
+
+        vector< Connection > next;
+        {
+            lock_guard< mutex > l( dispatch.lock );
+
+            for ( size_t i = 0; i < idle.size(); ++i )
+                if ( fds[2+i].revents != 0 )
+                    dispatch.readable.push_back( move( idle[i] ) ); // Readable, or hung up (read returns 0)
+                else
+                    next.push_back( move( idle[i] ) );
+
+            if ( fds[1].revents != 0 )
+            {
+                char bytes[256];
+                if ( read( dispatch.wakeup[0], bytes, sizeof( bytes ) ) < 0 && errno != EINTR )
+                    throw runtime_error( string( "cannot read pipe: " ) + strerror( errno ) );
+
+                for ( size_t i = 0; i < dispatch.served.size(); ++i )
+                    next.push_back( move( dispatch.served[i] ) );
+                dispatch.served.clear();
+            }
+        }
+
+        dispatch.ready.notify_all();
+        idle.swap( next );
+
+        if ( fds[0].revents != 0 )
+        {
+            Connection c;
+            c.fd = accept( listener, 0, 0 );
+            if ( c.fd >= 0 )
+                idle.push_back( move( c ) );
+        }
+    }
+}
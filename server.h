@@ -0,0 +1,44 @@
+/*
+ * This file must be used under the terms of the CeCILL.
+ * This source file is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution.  The terms
+ * are also available at
+ *   http://www.cecill.info/licences/Licence_CeCILL_V2.1-en.txt
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <memory>
+#include <string>
+#include "index.h"
+
+/*
+ * Query daemon over a Unix domain socket
+ *
+ * Line protocol, one query per line, one answer line per query, in order:
+ *
+ *      rel a b         --> a|b|r (CAIDA format, cf io.h), or a|b|none if a and b are not linked
+ *      cone y x        --> 1 if x is in the customer cone of y, 0 otherwise
+ *      size y          --> size of the customer cone of y (0 if y is unknown)
+ *      reload          --> ok n (n ASs) once the CAIDA file given to serve (reloadFile)
+ *                          replaces the snapshot, or error (also if there is no such file)
+ *      anything else   --> error
+ *
+ * A line longer than 1 kB gets "error line too long" and the connection is closed.
+ * Clients may send any number of queries before reading answers: all the complete
+ * lines received at once are answered against the same snapshot, in a single write.
+ * A reload builds the new index aside then swaps it atomically; queries in progress
+ * keep using the snapshot they started with.
+ *
+ * Clients cannot make the daemon open other files than reloadFile.
+ *
+ * The calling thread polls the idle connections. Each read of a readable connection is
+ * answered by one of a pool of threads, which then hands the connection back to be polled:
+ * a thread is never held by a connection waiting for queries. serve never returns.
+ */
+
+void serve( const string& socketPath, shared_ptr< const GraphIndex > index, unsigned int threads, const string& reloadFile );
+
+#endif
+